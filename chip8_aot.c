@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/CHIP-8.h"
+#include "core/instructions.h"
+#include "core/block_cache.h"
+
+/**
+ * Ahead-of-time translator: reads a ROM and emits a C source file that
+ * runs it as straight-line code on top of the emulator core.
+ *
+ * The control flow is recovered starting from the entry point by
+ * following jumps, calls, returns and skips. Each reachable basic block
+ * becomes a case of a switch on PC that executes the block without
+ * fetching or decoding. Code that is not reachable statically (the
+ * targets of Bnnn) and code that the program modifies at runtime are
+ * left to the interpreter.
+ */
+
+static int recover_blocks(CHIP8 *chip8, block_cache_t *cache, uint16_t rom_end, uint8_t *leaders);
+
+static void emit_program(FILE *out, const char *path, CHIP8 *chip8, block_cache_t *cache,
+                         int rom_length, const uint8_t *leaders);
+
+int main(int argc, char **argv) {
+    static CHIP8 chip8;
+
+    if (argc != 2 && argc != 3) {
+        fprintf(stdout, "USAGE: ./chip8_aot /path/to/rom [/path/to/output.c]\n");
+        return 1;
+    }
+
+    // one more byte than fits in memory tells oversized roms apart
+    uint8_t rom[MEMORY_SIZE - MEMORY_PGM_START + 1];
+    FILE *file = fopen(argv[1], "rb");
+
+    if (!file) {
+        fprintf(stderr, "Unable to read the provided rom! Aborting...\n");
+        return 1;
+    }
+
+    int rom_length = (int) fread(rom, 1, sizeof(rom), file);
+    fclose(file);
+
+    if (rom_length > MEMORY_SIZE - MEMORY_PGM_START) {
+        fprintf(stderr, "The provided rom does not fit in memory! Aborting...\n");
+        return 1;
+    }
+
+    CHIP8_init(&chip8);
+    CHIP8_load_rom_bytes(&chip8, rom, rom_length);
+
+    block_cache_t *cache = block_cache_create(0);
+    uint8_t leaders[MEMORY_SIZE] = {0};
+
+    if (!cache) {
+        fprintf(stderr, "Unable to allocate the block cache! Aborting...\n");
+        return 1;
+    }
+
+    int blocks = recover_blocks(&chip8, cache, MEMORY_PGM_START + rom_length, leaders);
+
+    FILE *out = stdout;
+    if (argc == 3 && !(out = fopen(argv[2], "w"))) {
+        fprintf(stderr, "Unable to write the output file! Aborting...\n");
+        return 1;
+    }
+
+    emit_program(out, argv[1], &chip8, cache, rom_length, leaders);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%s: translated %d blocks\n", argv[1], blocks);
+    block_cache_destroy(cache);
+
+    return 0;
+}
+
+/**
+ * Find the basic blocks reachable from the entry point.
+ * Blocks that extend past the end of the rom are not translated.
+ *
+ * @param chip8 is a pointer to the emulator holding the rom
+ * @param cache is the block cache used to decode the blocks
+ * @param rom_end is the first address after the rom
+ * @param leaders is set to 1 for the start address of every translated block
+ * @return the number of translated blocks
+ */
+static int recover_blocks(CHIP8 *chip8, block_cache_t *cache, uint16_t rom_end, uint8_t *leaders) {
+    uint16_t worklist[MEMORY_SIZE];
+    uint8_t visited[MEMORY_SIZE] = {0};
+    int pending = 0, blocks = 0;
+
+    worklist[pending++] = MEMORY_PGM_START;
+    visited[MEMORY_PGM_START] = 1;
+
+    while (pending) {
+        uint16_t address = worklist[--pending];
+        block_t *block = block_cache_fetch(cache, chip8, address);
+
+        if (block->end > rom_end) {
+            continue;
+        }
+
+        leaders[address] = 1;
+        blocks++;
+
+        const decoded_op_t *last = &block->ops[block->length - 1];
+        uint16_t successors[2];
+        int count = 0;
+
+        if (last->execute == &jump_immediate) {
+            successors[count++] = last->nnn;
+        } else if (last->execute == &call) {
+            successors[count++] = last->nnn;
+            successors[count++] = block->end;
+        } else if (last->execute == &skip_equal_imm || last->execute == &skip_not_equal_imm
+                   || last->execute == &skip_equal_reg || last->execute == &skip_ne_reg
+                   || last->execute == &skip_if_pressed || last->execute == &skip_if_not_pressed) {
+            successors[count++] = block->end;
+            successors[count++] = block->end + 2;
+        } else if (last->execute == &load_key) {
+            // load_key executes again until a key is pressed
+            successors[count++] = block->end - 2;
+            successors[count++] = block->end;
+        } else if (last->execute != &ret && last->execute != &jump_addr) {
+            successors[count++] = block->end;
+        }
+
+        for (int i = 0; i < count; i++) {
+            uint16_t next = successors[i];
+
+            if (next >= MEMORY_PGM_START && next < rom_end && !visited[next]) {
+                visited[next] = 1;
+                worklist[pending++] = next;
+            }
+        }
+    }
+
+    return blocks;
+}
+
+/**
+ * Write the C translation of the rom.
+ */
+static void emit_program(FILE *out, const char *path, CHIP8 *chip8, block_cache_t *cache,
+                         int rom_length, const uint8_t *leaders) {
+    uint8_t code_map[MEMORY_SIZE / 8] = {0};
+
+    fprintf(out, "/**\n * Translation of %s generated by chip8_aot. Do not edit.\n */\n\n", path);
+    fprintf(out, "#include \"core/CHIP-8.h\"\n#include \"core/instructions.h\"\n\n");
+    fprintf(out, "#define STEP(next_pc, execute, opcode) \\\n"
+                 "    chip8->draw_flag = 0; \\\n"
+                 "    chip8->PC = next_pc; \\\n"
+                 "    execute(chip8, opcode); \\\n"
+                 "    CHIP8_end_cycle(chip8)\n\n");
+
+    fprintf(out, "static int run(CHIP8 *chip8) {\n    switch (chip8->PC) {\n");
+
+    for (int address = 0; address < MEMORY_SIZE; address++) {
+        if (!leaders[address]) {
+            continue;
+        }
+
+        const block_t *block = block_cache_fetch(cache, chip8, address);
+        uint16_t pc = address;
+
+        fprintf(out, "        case 0x%03X:\n", address);
+        for (int i = 0; i < block->length; i++, pc += 2) {
+            const decoded_op_t *op = &block->ops[i];
+
+            if (op->execute == NULL) {
+                // not an instruction: the cycle is spent doing nothing
+                fprintf(out, "            chip8->draw_flag = 0;\n"
+                             "            chip8->PC = 0x%03X;\n"
+                             "            CHIP8_end_cycle(chip8);\n", pc + 2);
+            } else {
+                fprintf(out, "            STEP(0x%03X, %s, 0x%04X);\n",
+                        pc + 2, CHIP8_decode_instruction(chip8, op->opcode)->name, op->opcode);
+            }
+
+            code_map[pc / 8] |= 1 << (pc % 8);
+            code_map[(pc + 1) / 8] |= 1 << ((pc + 1) % 8);
+        }
+        fprintf(out, "            return %d;\n", block->length);
+    }
+
+    fprintf(out, "        default:\n            return 0;\n    }\n}\n\n");
+
+    fprintf(out, "static const uint8_t rom[] = {");
+    for (int i = 0; i < rom_length; i++) {
+        fprintf(out, "%s0x%02x,", i % 16 ? " " : "\n        ", chip8->memory[MEMORY_PGM_START + i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const uint8_t code_map[] = {");
+    for (int i = 0; i < MEMORY_SIZE / 8; i++) {
+        fprintf(out, "%s0x%02x,", i % 16 ? " " : "\n        ", code_map[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "const CHIP8_program CHIP8_translated_program = {rom, sizeof(rom), code_map, &run};\n");
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "core/CHIP-8.h"
+
+/**
+ * Benchmark: runs a set of ROMs for a fixed number of cycles, as fast as
+ * possible and without callbacks, and reports the throughput of every engine.
+ *
+ * For each ROM and engine, the emulated instructions and frames per second
+ * are measured. A second pass runs the ROM one cycle at a time on the
+ * interpreter and times every cycle, to report the cost of each opcode
+ * class (ISA entry). The peak resident set size of the process is
+ * reported at the end.
+ *
+ * The report is a single JSON document written to stdout, so that runs
+ * can be compared from one change of the core to the next.
+ */
+
+#define DEFAULT_CYCLES 10000000
+
+// the keyboard state changes every KEY_PERIOD cycles, so that roms waiting for keys make progress
+#define KEY_PERIOD 1000
+
+// number of timer reads used to measure the cost of reading the timer
+#define CALIBRATION_SAMPLES 100000
+
+// the opcodes that do not match any ISA entry are counted in the last class
+#define UNKNOWN_CLASS ISA_SIZE
+
+struct engine_s {
+    CHIP8_engine engine;
+    const char *name;
+};
+
+typedef struct engine_s engine_t;
+
+static const engine_t engines[] = {
+        {CHIP8_ENGINE_INTERPRETER,       "interpreter"},
+        {CHIP8_ENGINE_BLOCK_CACHE,       "block_cache"},
+        {CHIP8_ENGINE_SUPERINSTRUCTIONS, "superinstructions"},
+        {CHIP8_ENGINE_JIT,               "jit"},
+};
+
+#define NUM_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+struct opcode_class_s {
+    uint64_t count;
+    int64_t ns;
+};
+
+typedef struct opcode_class_s opcode_class_t;
+
+static void prepare(CHIP8 *chip8, const char *path, CHIP8_engine engine);
+
+static void press_keys(CHIP8 *chip8, uint64_t *next_toggle);
+
+static void bench_engine(const char *path, const engine_t *engine, uint64_t cycles);
+
+static void bench_opcodes(const char *path, uint64_t cycles);
+
+static int64_t timer_overhead();
+
+static void print_string(const char *string);
+
+int main(int argc, char **argv) {
+    uint64_t cycles = DEFAULT_CYCLES;
+    const char *only = NULL;
+    int first = 1;
+
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-n")) {
+            cycles = strtoull(argv[first + 1], NULL, 10);
+        } else if (!strcmp(argv[first], "-e")) {
+            only = argv[first + 1];
+        } else {
+            break;
+        }
+
+        first += 2;
+    }
+
+    int known = only == NULL;
+    for (size_t i = 0; i < NUM_ENGINES; i++) {
+        known |= only != NULL && !strcmp(only, engines[i].name);
+    }
+
+    if (first >= argc || cycles == 0 || !known) {
+        fprintf(stdout, "USAGE: ./chip8_bench [-n cycles] [-e interpreter|block_cache|superinstructions|jit] "
+                        "/path/to/rom...\n");
+        return 1;
+    }
+
+    fprintf(stdout, "{\n  \"cycles\": %llu,\n  \"roms\": [", (unsigned long long) cycles);
+
+    for (int i = first; i < argc; i++) {
+        fprintf(stdout, "%s\n    {\n      \"rom\": ", i > first ? "," : "");
+        print_string(argv[i]);
+        fprintf(stdout, ",\n      \"engines\": {");
+
+        int printed = 0;
+        for (size_t e = 0; e < NUM_ENGINES; e++) {
+            if (only == NULL || !strcmp(only, engines[e].name)) {
+                fprintf(stdout, "%s\n", printed++ ? "," : "");
+                bench_engine(argv[i], &engines[e], cycles);
+            }
+        }
+
+        fprintf(stdout, "\n      },\n      \"opcodes\": {");
+        bench_opcodes(argv[i], cycles);
+        fprintf(stdout, "\n      }\n    }");
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    // ru_maxrss is in kilobytes on Linux
+    fprintf(stdout, "\n  ],\n  \"peak_rss_kb\": %ld\n}\n", usage.ru_maxrss);
+
+    return 0;
+}
+
+/**
+ * Initialize an emulator without callbacks and with a fixed seed.
+ */
+static void prepare(CHIP8 *chip8, const char *path, CHIP8_engine engine) {
+    CHIP8_init(chip8);
+    CHIP8_set_engine(chip8, engine);
+    CHIP8_load_rom_from_file(chip8, (char *) path);
+    CHIP8_set_seed(chip8, 0);
+}
+
+/**
+ * Press and release the keys in a fixed pattern once the emulator
+ * has gone past the next toggle.
+ */
+static void press_keys(CHIP8 *chip8, uint64_t *next_toggle) {
+    while (chip8->cycle_count >= *next_toggle) {
+        int key = (*next_toggle / KEY_PERIOD) % NUM_KEYS;
+
+        CHIP8_key_event(chip8, key, !((chip8->keys >> key) & 1));
+        *next_toggle += KEY_PERIOD;
+    }
+}
+
+/**
+ * Run a rom on an engine and print the instructions and frames
+ * emulated per second.
+ */
+static void bench_engine(const char *path, const engine_t *engine, uint64_t cycles) {
+    static CHIP8 chip8;
+    uint64_t next_toggle = KEY_PERIOD;
+
+    prepare(&chip8, path, engine->engine);
+
+    int64_t start = CHIP8_time_ns();
+    while (chip8.cycle_count < cycles) {
+        CHIP8_step(&chip8);
+        press_keys(&chip8, &next_toggle);
+    }
+    int64_t elapsed = CHIP8_time_ns() - start;
+
+    double seconds = elapsed / 1e9;
+
+    fprintf(stdout, "        \"%s\": {\"seconds\": %.6f, \"instructions_per_second\": %.0f, "
+                    "\"frames_per_second\": %.0f}",
+            engine->name, seconds, chip8.cycle_count / seconds, chip8.frame_count / seconds);
+
+    // release the block cache and the translated code
+    CHIP8_set_engine(&chip8, CHIP8_ENGINE_INTERPRETER);
+}
+
+/**
+ * Run a rom on the interpreter one cycle at a time and print the number
+ * of cycles and the average time of a cycle for each opcode class.
+ * The cost of reading the timer is measured first and subtracted.
+ */
+static void bench_opcodes(const char *path, uint64_t cycles) {
+    static CHIP8 chip8;
+    static opcode_class_t classes[ISA_SIZE + 1];
+    uint64_t next_toggle = KEY_PERIOD;
+
+    memset(classes, 0, sizeof(classes));
+    prepare(&chip8, path, CHIP8_ENGINE_INTERPRETER);
+
+    int64_t overhead = timer_overhead();
+
+    while (chip8.cycle_count < cycles) {
+        uint16_t opcode = (chip8.memory[chip8.PC] << 8) | chip8.memory[chip8.PC + 1];
+        const instruction_t *instruction = CHIP8_decode_instruction(&chip8, opcode);
+        int index = instruction != NULL ? (int) (instruction - chip8.ISA) : UNKNOWN_CLASS;
+
+        // a cycle waiting for a key does not execute its opcode
+        if (chip8.waiting_key) {
+            index = UNKNOWN_CLASS;
+        }
+
+        int64_t start = CHIP8_time_ns();
+        CHIP8_tick(&chip8);
+        classes[index].ns += CHIP8_time_ns() - start - overhead;
+        classes[index].count++;
+
+        press_keys(&chip8, &next_toggle);
+    }
+
+    int printed = 0;
+    for (int i = 0; i <= ISA_SIZE; i++) {
+        if (classes[i].count == 0) {
+            continue;
+        }
+
+        double ns = (double) classes[i].ns / classes[i].count;
+
+        fprintf(stdout, "%s\n        \"%s\": {\"count\": %llu, \"ns_per_op\": %.2f}", printed++ ? "," : "",
+                i < ISA_SIZE ? chip8.ISA[i].name : "other", (unsigned long long) classes[i].count,
+                ns > 0 ? ns : 0);
+    }
+}
+
+/**
+ * Measure the time between two consecutive reads of the clock
+ */
+static int64_t timer_overhead() {
+    int64_t total = 0;
+
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++) {
+        int64_t start = CHIP8_time_ns();
+        total += CHIP8_time_ns() - start;
+    }
+
+    return total / CALIBRATION_SAMPLES;
+}
+
+/**
+ * Print a string as a JSON string literal
+ */
+static void print_string(const char *string) {
+    fputc('"', stdout);
+
+    for (const char *c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(stdout, "\\%c", *c);
+        } else if ((unsigned char) *c < 0x20) {
+            fprintf(stdout, "\\u%04x", *c);
+        } else {
+            fputc(*c, stdout);
+        }
+    }
+
+    fputc('"', stdout);
+}
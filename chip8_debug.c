@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "core/CHIP-8.h"
+#include "core/debugger.h"
+#include "core/assembler.h"
+
+/**
+ * Debugger: runs a ROM headless and reads commands from stdin.
+ *
+ *     break ADDRESS [if OPERAND OP VALUE]   stop at an address (V0-VF, I, DT, ST; == != < <= > >=)
+ *     delete N                              remove breakpoint N
+ *     watch ADDRESS [LENGTH] | watch I      stop after a write to memory, or a change of I
+ *     unwatch ADDRESS [LENGTH] | unwatch I  stop watching
+ *     continue [CYCLES]                     run until a breakpoint or a watchpoint
+ *     step [N]                              execute N instructions
+ *     next                                  execute an instruction, or a whole CALL
+ *     regs, x ADDRESS [LENGTH], screen      show the registers, the memory, the screen
+ *     key KEY 1|0                           press or release a key
+ *     list, help, quit
+ *
+ * Without breakpoints and watchpoints, continue runs the selected engine
+ * at full speed; the debugger only checks the instructions while
+ * something is armed (see debugger.h).
+ */
+
+#define DEFAULT_CONTINUE_CYCLES 100000000
+#define MAX_COMMAND_LENGTH 256
+#define MAX_WORDS 8
+
+struct engine_s {
+    CHIP8_engine engine;
+    const char *name;
+};
+
+typedef struct engine_s engine_t;
+
+static const engine_t engines[] = {
+        {CHIP8_ENGINE_INTERPRETER,       "interpreter"},
+        {CHIP8_ENGINE_BLOCK_CACHE,       "block_cache"},
+        {CHIP8_ENGINE_SUPERINSTRUCTIONS, "superinstructions"},
+        {CHIP8_ENGINE_JIT,               "jit"},
+};
+
+#define NUM_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+static const char *operand_names[] = {
+        "V0", "V1", "V2", "V3", "V4", "V5", "V6", "V7",
+        "V8", "V9", "VA", "VB", "VC", "VD", "VE", "VF",
+        [DEBUG_OPERAND_I] = "I",
+        [DEBUG_OPERAND_DT] = "DT",
+        [DEBUG_OPERAND_ST] = "ST",
+};
+
+#define NUM_OPERANDS (sizeof(operand_names) / sizeof(operand_names[0]))
+
+static const char *comparison_names[] = {
+        [DEBUG_ALWAYS] = "",
+        [DEBUG_EQUAL] = "==",
+        [DEBUG_NOT_EQUAL] = "!=",
+        [DEBUG_LESS] = "<",
+        [DEBUG_LESS_EQUAL] = "<=",
+        [DEBUG_GREATER] = ">",
+        [DEBUG_GREATER_EQUAL] = ">=",
+};
+
+#define NUM_COMPARISONS (sizeof(comparison_names) / sizeof(comparison_names[0]))
+
+static debugger_t debugger;
+
+static void execute_command(CHIP8 *chip8, char **words, int count);
+
+static void report_stop(const CHIP8 *chip8, debug_stop stop, uint64_t executed);
+
+static void print_location(const CHIP8 *chip8);
+
+static void print_registers(const CHIP8 *chip8);
+
+static void print_memory(const CHIP8 *chip8, uint16_t address, uint16_t length);
+
+static void print_screen(const CHIP8 *chip8);
+
+static void print_breakpoints();
+
+static int parse_number(const char *text, long *value);
+
+static int parse_condition(char **words, debug_condition_t *condition);
+
+int main(int argc, char **argv) {
+    static CHIP8 chip8;
+    CHIP8_engine engine = CHIP8_ENGINE_INTERPRETER;
+    int first = 1;
+
+    if (argc == 4 && !strcmp(argv[1], "-e")) {
+        size_t e;
+
+        for (e = 0; e < NUM_ENGINES && strcmp(argv[2], engines[e].name); e++);
+        engine = e < NUM_ENGINES ? engines[e].engine : (CHIP8_engine) -1;
+        first = 3;
+    }
+
+    if (first + 1 != argc || engine == (CHIP8_engine) -1) {
+        fprintf(stdout, "USAGE: ./chip8_debug [-e interpreter|block_cache|superinstructions|jit] /path/to/rom\n");
+        return 1;
+    }
+
+    CHIP8_init(&chip8);
+    CHIP8_set_seed(&chip8, 0);
+    CHIP8_load_rom_from_file(&chip8, argv[first]);
+    CHIP8_set_engine(&chip8, engine);
+    debugger_init(&debugger);
+
+    char line[MAX_COMMAND_LENGTH];
+
+    print_location(&chip8);
+    fprintf(stdout, "(chip8) ");
+    fflush(stdout);
+
+    while (fgets(line, sizeof(line), stdin)) {
+        char *words[MAX_WORDS];
+        int count = 0;
+
+        for (char *word = strtok(line, " \t\r\n"); word && count < MAX_WORDS; word = strtok(NULL, " \t\r\n")) {
+            words[count++] = word;
+        }
+
+        if (count > 0 && (!strcmp(words[0], "quit") || !strcmp(words[0], "q"))) {
+            break;
+        }
+
+        if (count > 0) {
+            execute_command(&chip8, words, count);
+        }
+
+        fprintf(stdout, "(chip8) ");
+        fflush(stdout);
+    }
+
+    CHIP8_set_engine(&chip8, CHIP8_ENGINE_INTERPRETER);
+    return 0;
+}
+
+static void execute_command(CHIP8 *chip8, char **words, int count) {
+    const char *command = words[0];
+    long value = 0, length = 1;
+    uint64_t executed;
+
+    if (!strcmp(command, "break") || !strcmp(command, "b")) {
+        debug_condition_t condition = {0, DEBUG_ALWAYS, 0};
+
+        if ((count != 2 && count != 6) || !parse_number(words[1], &value)
+            || (count == 6 && (strcmp(words[2], "if") || !parse_condition(words + 3, &condition)))) {
+            fprintf(stdout, "usage: break ADDRESS [if OPERAND OP VALUE]\n");
+            return;
+        }
+
+        int index = debugger_add_breakpoint(&debugger, value, &condition);
+
+        if (index < 0) {
+            fprintf(stdout, "Too many breakpoints\n");
+        } else {
+            fprintf(stdout, "Breakpoint %d at 0x%03X\n", index, (unsigned) value & 0xFFF);
+        }
+    } else if (!strcmp(command, "delete") || !strcmp(command, "d")) {
+        if (count != 2 || !parse_number(words[1], &value) || !debugger_remove_breakpoint(&debugger, (int) value)) {
+            fprintf(stdout, "usage: delete BREAKPOINT\n");
+        }
+    } else if (!strcmp(command, "watch") || !strcmp(command, "unwatch")) {
+        int enabled = !strcmp(command, "watch");
+
+        if (count == 2 && !strcasecmp(words[1], "I")) {
+            debugger_watch_I(&debugger, enabled);
+        } else if ((count == 2 || count == 3) && parse_number(words[1], &value)
+                   && (count == 2 || parse_number(words[2], &length))) {
+            debugger_watch_memory(&debugger, value & 0xFFF, length, enabled);
+        } else {
+            fprintf(stdout, "usage: %s ADDRESS [LENGTH] | %s I\n", command, command);
+        }
+    } else if (!strcmp(command, "continue") || !strcmp(command, "c")) {
+        value = DEFAULT_CONTINUE_CYCLES;
+
+        if (count == 2 && !parse_number(words[1], &value)) {
+            fprintf(stdout, "usage: continue [CYCLES]\n");
+            return;
+        }
+
+        debug_stop stop = debugger_run(&debugger, chip8, value, &executed);
+
+        report_stop(chip8, stop, executed);
+    } else if (!strcmp(command, "step") || !strcmp(command, "s")) {
+        value = 1;
+        if (count == 2 && !parse_number(words[1], &value)) {
+            fprintf(stdout, "usage: step [N]\n");
+            return;
+        }
+
+        debug_stop stop = debugger_step(&debugger, chip8, value, &executed);
+
+        report_stop(chip8, stop, executed);
+    } else if (!strcmp(command, "next") || !strcmp(command, "n")) {
+        debug_stop stop = debugger_step_over(&debugger, chip8, DEFAULT_CONTINUE_CYCLES, &executed);
+
+        report_stop(chip8, stop, executed);
+    } else if (!strcmp(command, "regs") || !strcmp(command, "r")) {
+        print_registers(chip8);
+    } else if (!strcmp(command, "x")) {
+        length = 16;
+
+        if ((count != 2 && count != 3) || !parse_number(words[1], &value)
+            || (count == 3 && !parse_number(words[2], &length))) {
+            fprintf(stdout, "usage: x ADDRESS [LENGTH]\n");
+            return;
+        }
+
+        print_memory(chip8, value, length);
+    } else if (!strcmp(command, "screen")) {
+        print_screen(chip8);
+    } else if (!strcmp(command, "key")) {
+        long pressed;
+
+        if (count != 3 || !parse_number(words[1], &value) || value < 0 || value > 0xF
+            || !parse_number(words[2], &pressed)) {
+            fprintf(stdout, "usage: key KEY 1|0\n");
+            return;
+        }
+
+        CHIP8_key_event(chip8, value, pressed != 0);
+    } else if (!strcmp(command, "list") || !strcmp(command, "l")) {
+        print_breakpoints();
+    } else if (!strcmp(command, "help") || !strcmp(command, "h")) {
+        fprintf(stdout, "break ADDRESS [if OPERAND OP VALUE], delete N, watch ADDRESS [LENGTH] | watch I,\n"
+                        "unwatch ADDRESS [LENGTH] | unwatch I, continue [CYCLES], step [N], next,\n"
+                        "regs, x ADDRESS [LENGTH], screen, key KEY 1|0, list, help, quit\n");
+    } else {
+        fprintf(stdout, "Unknown command '%s' (try help)\n", command);
+    }
+}
+
+/**
+ * Print why the emulator stopped and the next instruction
+ */
+static void report_stop(const CHIP8 *chip8, debug_stop stop, uint64_t executed) {
+    switch (stop) {
+        case DEBUG_STOP_BREAKPOINT:
+            fprintf(stdout, "Breakpoint %d, ", debugger.breakpoint);
+            break;
+        case DEBUG_STOP_WATCH_MEMORY:
+            fprintf(stdout, "Memory 0x%03X written (now 0x%02X), ", debugger.watch_address,
+                    chip8->memory[debugger.watch_address]);
+            break;
+        case DEBUG_STOP_WATCH_I:
+            fprintf(stdout, "I changed from 0x%03X to 0x%03X, ", debugger.previous_I, chip8->I);
+            break;
+        case DEBUG_STOP_KEY_WAIT:
+            fprintf(stdout, "Waiting for a key (see the key command), ");
+            break;
+        default:
+            break;
+    }
+
+    fprintf(stdout, "%llu cycles executed\n", (unsigned long long) executed);
+    print_location(chip8);
+}
+
+static void print_location(const CHIP8 *chip8) {
+    uint16_t opcode = (chip8->memory[chip8->PC & 0xFFF] << 8) | chip8->memory[(chip8->PC + 1) & 0xFFF];
+    char text[32];
+
+    disassemble_instruction(opcode, text, sizeof(text));
+    fprintf(stdout, "0x%03X: %04X  %s\n", chip8->PC, opcode, text);
+}
+
+static void print_registers(const CHIP8 *chip8) {
+    for (int i = 0; i < 16; i++) {
+        fprintf(stdout, "V%X=%02X%s", i, chip8->register_file.raw[i], i % 8 == 7 ? "\n" : " ");
+    }
+
+    fprintf(stdout, "I=%03X PC=%03X SP=%X DT=%02X ST=%02X cycle=%llu\n", chip8->I, chip8->PC, chip8->SP,
+            chip8->delay_timer, chip8->sound_timer, (unsigned long long) chip8->cycle_count);
+
+    for (int i = chip8->SP - 1; i >= 0 && i < 16; i--) {
+        fprintf(stdout, "  stack[%d] = 0x%03X\n", i, chip8->stack[i]);
+    }
+}
+
+static void print_memory(const CHIP8 *chip8, uint16_t address, uint16_t length) {
+    for (uint32_t a = address; a < (uint32_t) address + length && a < 4096; a++) {
+        if (a == address || a % 16 == 0) {
+            fprintf(stdout, "%s0x%03X:", a == address ? "" : "\n", a);
+        }
+
+        fprintf(stdout, " %02X", chip8->memory[a]);
+    }
+
+    fprintf(stdout, "\n");
+}
+
+static void print_screen(const CHIP8 *chip8) {
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        for (int x = 0; x < VIDEO_WIDTH; x++) {
+            fputc(chip8->video[y] >> (VIDEO_WIDTH - 1 - x) & 1 ? '#' : '.', stdout);
+        }
+
+        fputc('\n', stdout);
+    }
+}
+
+static void print_breakpoints() {
+    for (int i = 0; i < DEBUGGER_MAX_BREAKPOINTS; i++) {
+        const breakpoint_t *breakpoint = &debugger.breakpoints[i];
+
+        if (!breakpoint->active) {
+            continue;
+        }
+
+        fprintf(stdout, "Breakpoint %d at 0x%03X", i, breakpoint->address);
+        if (breakpoint->condition.comparison != DEBUG_ALWAYS) {
+            fprintf(stdout, " if %s %s 0x%X", operand_names[breakpoint->condition.operand],
+                    comparison_names[breakpoint->condition.comparison], breakpoint->condition.value);
+        }
+        fprintf(stdout, ", hit %llu times\n", (unsigned long long) breakpoint->hits);
+    }
+
+    for (int a = 0; a < 4096; a++) {
+        if (debugger.watched[a] && (a == 0 || !debugger.watched[a - 1])) {
+            int end = a;
+
+            while (end + 1 < 4096 && debugger.watched[end + 1]) {
+                end++;
+            }
+
+            fprintf(stdout, "Watching 0x%03X-0x%03X\n", a, end);
+        }
+    }
+
+    if (debugger.watch_I) {
+        fprintf(stdout, "Watching I\n");
+    }
+}
+
+/**
+ * Parse a decimal, hexadecimal (0x) or octal (0) number
+ */
+static int parse_number(const char *text, long *value) {
+    char *end;
+
+    *value = strtol(text, &end, 0);
+    return *text != '\0' && *end == '\0';
+}
+
+/**
+ * Parse OPERAND OP VALUE (three words)
+ */
+static int parse_condition(char **words, debug_condition_t *condition) {
+    long value;
+    size_t operand, comparison;
+
+    for (operand = 0; operand < NUM_OPERANDS && strcasecmp(words[0], operand_names[operand]); operand++);
+    for (comparison = 1; comparison < NUM_COMPARISONS && strcmp(words[1], comparison_names[comparison]); comparison++);
+
+    if (operand == NUM_OPERANDS || comparison == NUM_COMPARISONS || !parse_number(words[2], &value)) {
+        return 0;
+    }
+
+    condition->operand = operand;
+    condition->comparison = comparison;
+    condition->value = value;
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,543 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "core/CHIP-8.h"
+#include "core/input_record.h"
+
+/**
+ * Fleet runner: runs every ROM of a directory headless, on all the cores,
+ * and checks the emulators against golden hashes.
+ *
+ * Each ROM (.c8 or .ch8) runs up to the given cycle checkpoints. If a
+ * recording with the same name and the .rec extension is next to it
+ * (see input_record.h), its keys are replayed; otherwise no key is
+ * pressed. At every checkpoint the video memory and the whole machine
+ * state (registers, memory, timers) are hashed. The hashes do not depend
+ * on the engine or on the number of threads.
+ *
+ * The ROMs are distributed to a pool of threads, each with its own queue;
+ * a thread whose queue is empty steals from the others. The hashes are
+ * compared to a golden file (-g), or written to it (-w), and the
+ * throughput in ROM-cycles per second across the threads is reported.
+ *
+ * Golden file: one line per ROM and checkpoint, "rom cycle video state"
+ * with the hashes in hexadecimal. Lines starting with # are ignored.
+ */
+
+#define DEFAULT_CHECKPOINTS "100000,1000000,10000000"
+#define MAX_CHECKPOINTS 16
+#define MAX_THREADS 256
+#define MAX_ROM_SIZE (4096 - MEMORY_PGM_START)
+
+enum job_status_e {
+    JOB_PENDING,
+    JOB_DONE,
+    JOB_ERROR
+};
+
+typedef enum job_status_e job_status;
+
+struct job_s {
+    char name[NAME_MAX + 1];
+    job_status status;
+    uint64_t video[MAX_CHECKPOINTS];
+    uint64_t state[MAX_CHECKPOINTS];
+};
+
+typedef struct job_s job_t;
+
+/**
+ * A thread of the pool: it takes the jobs at the tail of its queue,
+ * the other threads steal them from the head
+ */
+struct worker_s {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int *queue;
+    int head;
+    int tail;
+
+    uint64_t cycles;
+    int stolen;
+};
+
+typedef struct worker_s worker_t;
+
+struct golden_s {
+    char name[NAME_MAX + 1];
+    uint64_t cycle;
+    uint64_t video;
+    uint64_t state;
+};
+
+typedef struct golden_s golden_t;
+
+struct engine_s {
+    CHIP8_engine engine;
+    const char *name;
+};
+
+typedef struct engine_s engine_t;
+
+static const engine_t engines[] = {
+        {CHIP8_ENGINE_INTERPRETER,       "interpreter"},
+        {CHIP8_ENGINE_BLOCK_CACHE,       "block_cache"},
+        {CHIP8_ENGINE_SUPERINSTRUCTIONS, "superinstructions"},
+        {CHIP8_ENGINE_JIT,               "jit"},
+};
+
+#define NUM_ENGINES (sizeof(engines) / sizeof(engines[0]))
+
+/**
+ * Configuration shared by the threads, read-only while they run
+ */
+static const char *directory;
+static CHIP8_engine engine = CHIP8_ENGINE_INTERPRETER;
+static uint64_t checkpoints[MAX_CHECKPOINTS];
+static int num_checkpoints;
+
+static job_t *jobs;
+static int num_jobs;
+
+static worker_t workers[MAX_THREADS];
+static int num_workers;
+
+static int list_roms(const char *path);
+
+static int compare_jobs(const void *a, const void *b);
+
+static int compare_golden(const void *a, const void *b);
+
+static int parse_checkpoints(const char *list);
+
+static void *worker_thread(void *arg);
+
+static int next_job(int id);
+
+static void run_job(job_t *job, uint64_t *cycles);
+
+static uint64_t video_hash(const CHIP8 *chip8);
+
+static golden_t *read_golden(const char *path, int *count);
+
+static int write_golden(const char *path);
+
+static int compare_job(const job_t *job, const golden_t *golden, int count);
+
+int main(int argc, char **argv) {
+    const char *golden_path = NULL, *list = DEFAULT_CHECKPOINTS;
+    int update = 0;
+    int first = 1;
+
+    num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    while (first < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-w")) {
+            update = 1;
+            first += 1;
+            continue;
+        } else if (first + 1 >= argc) {
+            break;
+        } else if (!strcmp(argv[first], "-j")) {
+            num_workers = atoi(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-c")) {
+            list = argv[first + 1];
+        } else if (!strcmp(argv[first], "-g")) {
+            golden_path = argv[first + 1];
+        } else if (!strcmp(argv[first], "-e")) {
+            size_t e;
+
+            for (e = 0; e < NUM_ENGINES && strcmp(argv[first + 1], engines[e].name); e++);
+            engine = e < NUM_ENGINES ? engines[e].engine : (CHIP8_engine) -1;
+        } else {
+            break;
+        }
+
+        first += 2;
+    }
+
+    if (first + 1 != argc || num_workers < 1 || num_workers > MAX_THREADS || engine == (CHIP8_engine) -1
+        || !parse_checkpoints(list) || (update && !golden_path)) {
+        fprintf(stdout, "USAGE: ./chip8_fleet [-j threads] [-e interpreter|block_cache|superinstructions|jit] "
+                        "[-c cycle,cycle...] [-g golden [-w]] /path/to/roms\n");
+        return 1;
+    }
+
+    directory = argv[first];
+    if (!list_roms(directory)) {
+        fprintf(stderr, "Unable to list the roms! Aborting...\n");
+        return 1;
+    }
+
+    // the jobs are dealt to the queues in turn, the threads balance them by stealing
+    for (int w = 0; w < num_workers; w++) {
+        workers[w].queue = malloc((num_jobs / num_workers + 1) * sizeof(int));
+
+        if (!workers[w].queue) {
+            fprintf(stderr, "Unable to allocate the queues! Aborting...\n");
+            return 1;
+        }
+
+        pthread_mutex_init(&workers[w].lock, NULL);
+    }
+
+    for (int j = 0; j < num_jobs; j++) {
+        worker_t *worker = &workers[j % num_workers];
+        worker->queue[worker->tail++] = j;
+    }
+
+    int64_t start = CHIP8_time_ns();
+
+    for (int w = 0; w < num_workers; w++) {
+        if (pthread_create(&workers[w].thread, NULL, &worker_thread, (void *) (intptr_t) w)) {
+            fprintf(stderr, "Unable to create the threads! Aborting...\n");
+            return 1;
+        }
+    }
+
+    uint64_t cycles = 0;
+    int stolen = 0;
+
+    for (int w = 0; w < num_workers; w++) {
+        pthread_join(workers[w].thread, NULL);
+        cycles += workers[w].cycles;
+        stolen += workers[w].stolen;
+    }
+
+    double seconds = (CHIP8_time_ns() - start) / 1e9;
+
+    // results
+    int passed = 0, failed = 0, errors = 0;
+    int count = 0;
+    golden_t *golden = NULL;
+
+    if (golden_path && !update && !(golden = read_golden(golden_path, &count))) {
+        fprintf(stderr, "Unable to read the golden file! Aborting...\n");
+        return 1;
+    }
+
+    for (int j = 0; j < num_jobs; j++) {
+        if (jobs[j].status == JOB_ERROR) {
+            fprintf(stdout, "ERROR %s: unable to load the rom or its recording\n", jobs[j].name);
+            errors++;
+        } else if (golden) {
+            compare_job(&jobs[j], golden, count) ? passed++ : failed++;
+        }
+    }
+
+    if (update && !write_golden(golden_path)) {
+        fprintf(stderr, "Unable to write the golden file! Aborting...\n");
+        return 1;
+    }
+
+    fprintf(stdout, "%d roms", num_jobs);
+    if (golden) {
+        fprintf(stdout, ", %d passed, %d failed", passed, failed);
+    } else if (update) {
+        fprintf(stdout, ", golden hashes written to %s", golden_path);
+    }
+    fprintf(stdout, ", %d errors\n", errors);
+
+    fprintf(stdout, "%llu rom-cycles in %.3f s on %d threads (%d roms stolen): %.1f M rom-cycles/s\n",
+            (unsigned long long) cycles, seconds, num_workers, stolen, cycles / seconds / 1e6);
+
+    free(golden);
+    return failed || errors ? 2 : 0;
+}
+
+/**
+ * Collect the roms of a directory, sorted by name
+ */
+static int list_roms(const char *path) {
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    int capacity = 0;
+
+    if (!dir) {
+        return 0;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        const char *extension = strrchr(entry->d_name, '.');
+
+        if (!extension || (strcmp(extension, ".c8") && strcmp(extension, ".ch8"))) {
+            continue;
+        }
+
+        if (num_jobs == capacity) {
+            job_t *grown = realloc(jobs, (capacity = capacity ? 2 * capacity : 64) * sizeof(job_t));
+
+            if (!grown) {
+                closedir(dir);
+                return 0;
+            }
+
+            jobs = grown;
+        }
+
+        memset(&jobs[num_jobs], 0, sizeof(job_t));
+        snprintf(jobs[num_jobs].name, sizeof(jobs[num_jobs].name), "%s", entry->d_name);
+        num_jobs++;
+    }
+
+    closedir(dir);
+    qsort(jobs, num_jobs, sizeof(job_t), &compare_jobs);
+    return 1;
+}
+
+static int compare_jobs(const void *a, const void *b) {
+    return strcmp(((const job_t *) a)->name, ((const job_t *) b)->name);
+}
+
+/**
+ * Order of the golden hashes: by rom, then by cycle
+ */
+static int compare_golden(const void *a, const void *b) {
+    const golden_t *x = a, *y = b;
+    int order = strcmp(x->name, y->name);
+
+    return order ? order : (x->cycle > y->cycle) - (x->cycle < y->cycle);
+}
+
+/**
+ * Parse a comma-separated list of increasing cycle counts
+ */
+static int parse_checkpoints(const char *list) {
+    const char *p = list;
+
+    num_checkpoints = 0;
+    while (*p && num_checkpoints < MAX_CHECKPOINTS) {
+        char *end;
+        uint64_t cycle = strtoull(p, &end, 10);
+
+        if (end == p || (*end && *end != ',') || cycle == 0
+            || (num_checkpoints && cycle <= checkpoints[num_checkpoints - 1])) {
+            return 0;
+        }
+
+        checkpoints[num_checkpoints++] = cycle;
+        p = *end ? end + 1 : end;
+    }
+
+    return num_checkpoints > 0 && !*p;
+}
+
+static void *worker_thread(void *arg) {
+    int id = (int) (intptr_t) arg;
+    int j;
+
+    while ((j = next_job(id)) >= 0) {
+        run_job(&jobs[j], &workers[id].cycles);
+    }
+
+    return NULL;
+}
+
+/**
+ * Take a job from the own queue, or steal one from the other threads.
+ * No job is added once the threads run, so empty queues stay empty.
+ *
+ * @return the index of the job, -1 when all the queues are empty
+ */
+static int next_job(int id) {
+    for (int i = 0; i < num_workers; i++) {
+        worker_t *worker = &workers[(id + i) % num_workers];
+        int j = -1;
+
+        pthread_mutex_lock(&worker->lock);
+        if (worker->head < worker->tail) {
+            j = i == 0 ? worker->queue[--worker->tail] : worker->queue[worker->head++];
+        }
+        pthread_mutex_unlock(&worker->lock);
+
+        if (j >= 0) {
+            workers[id].stolen += i != 0;
+            return j;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Run a rom up to the checkpoints and hash the emulator at each of them
+ */
+static void run_job(job_t *job, uint64_t *cycles) {
+    char path[PATH_MAX], script[PATH_MAX];
+    uint8_t rom[MAX_ROM_SIZE + 1];
+    CHIP8 *chip8 = aligned_alloc(CHIP8_CACHE_LINE, sizeof(CHIP8));
+    input_record_t *replay = NULL;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, job->name);
+    snprintf(script, sizeof(script), "%s/%.*s.rec", directory,
+             (int) (strrchr(job->name, '.') - job->name), job->name);
+
+    FILE *file = fopen(path, "rb");
+    size_t length = file ? fread(rom, 1, sizeof(rom), file) : 0;
+
+    if (file) {
+        fclose(file);
+    }
+
+    job->status = JOB_ERROR;
+    if (!chip8 || length == 0 || length > MAX_ROM_SIZE) {
+        free(chip8);
+        return;
+    }
+
+    CHIP8_init(chip8);
+    CHIP8_set_seed(chip8, 0);
+    CHIP8_load_rom_bytes(chip8, rom, (int) length);
+
+    // the recording sets the seed and the clock rate of its session
+    if (access(script, F_OK) == 0 && !(replay = input_record_open(script, chip8))) {
+        free(chip8);
+        return;
+    }
+
+    CHIP8_set_engine(chip8, engine);
+
+    for (int c = 0; c < num_checkpoints; c++) {
+        if (replay) {
+            input_replay_run(replay, chip8, checkpoints[c] - chip8->cycle_count);
+        }
+
+        // the last cycles are executed one at a time, to stop right at the checkpoint
+        while (chip8->cycle_count < checkpoints[c]) {
+            if (checkpoints[c] - chip8->cycle_count > CHIP8_MAX_STEP_CYCLES) {
+                CHIP8_step(chip8);
+            } else {
+                CHIP8_tick(chip8);
+            }
+        }
+
+        job->video[c] = video_hash(chip8);
+        job->state[c] = CHIP8_state_hash(chip8);
+    }
+
+    *cycles += chip8->cycle_count;
+    job->status = JOB_DONE;
+
+    if (replay) {
+        input_record_close(replay);
+    }
+
+    CHIP8_set_engine(chip8, CHIP8_ENGINE_INTERPRETER);
+    free(chip8);
+}
+
+/**
+ * FNV-1a hash of the video memory
+ */
+static uint64_t video_hash(const CHIP8 *chip8) {
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            hash = (hash ^ ((chip8->video[y] >> shift) & 0xFF)) * 0x100000001B3;
+        }
+    }
+
+    return hash;
+}
+
+static golden_t *read_golden(const char *path, int *count) {
+    FILE *file = fopen(path, "r");
+    golden_t *golden = NULL;
+    int capacity = 0;
+    char line[NAME_MAX + 128];
+
+    if (!file) {
+        return NULL;
+    }
+
+    *count = 0;
+    while (fgets(line, sizeof(line), file)) {
+        golden_t entry;
+        unsigned long long cycle, video, state;
+
+        if (line[0] == '#' || sscanf(line, "%255s %llu %llx %llx", entry.name, &cycle, &video, &state) != 4) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            golden_t *grown = realloc(golden, (capacity = capacity ? 2 * capacity : 64) * sizeof(golden_t));
+
+            if (!grown) {
+                free(golden);
+                fclose(file);
+                return NULL;
+            }
+
+            golden = grown;
+        }
+
+        entry.cycle = cycle;
+        entry.video = video;
+        entry.state = state;
+        golden[(*count)++] = entry;
+    }
+
+    fclose(file);
+
+    // an empty file is valid: every rom is reported without golden hashes
+    if (golden == NULL) {
+        return calloc(1, sizeof(golden_t));
+    }
+
+    qsort(golden, *count, sizeof(golden_t), &compare_golden);
+    return golden;
+}
+
+static int write_golden(const char *path) {
+    FILE *file = fopen(path, "w");
+
+    if (!file) {
+        return 0;
+    }
+
+    fprintf(file, "# rom cycle video state\n");
+    for (int j = 0; j < num_jobs; j++) {
+        for (int c = 0; c < num_checkpoints && jobs[j].status == JOB_DONE; c++) {
+            fprintf(file, "%s %llu %016llx %016llx\n", jobs[j].name, (unsigned long long) checkpoints[c],
+                    (unsigned long long) jobs[j].video[c], (unsigned long long) jobs[j].state[c]);
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+/**
+ * Compare the hashes of a rom to the golden ones and report the first difference
+ *
+ * @return 1 if all the checkpoints match, 0 otherwise
+ */
+static int compare_job(const job_t *job, const golden_t *golden, int count) {
+    for (int c = 0; c < num_checkpoints; c++) {
+        golden_t key;
+
+        snprintf(key.name, sizeof(key.name), "%s", job->name);
+        key.cycle = checkpoints[c];
+
+        const golden_t *expected = bsearch(&key, golden, count, sizeof(golden_t), &compare_golden);
+
+        if (expected == NULL) {
+            fprintf(stdout, "FAIL %s: no golden hash at cycle %llu\n", job->name, (unsigned long long) checkpoints[c]);
+            return 0;
+        }
+
+        if (expected->video != job->video[c] || expected->state != job->state[c]) {
+            fprintf(stdout, "FAIL %s: %s differs at cycle %llu\n", job->name,
+                    expected->video != job->video[c] ? "video" : "state", (unsigned long long) checkpoints[c]);
+            return 0;
+        }
+    }
+
+    fprintf(stdout, "PASS %s\n", job->name);
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+
+#include "core/CHIP-8.h"
+
+/**
+ * Event loop host: runs many emulators in a single thread.
+ *
+ * Every emulator owns a timer file descriptor armed at the deadline
+ * reported by CHIP8_run. The thread sleeps in epoll_wait and runs
+ * an emulator only when its timer expires. At the end, the number
+ * of emulated cycles and the CPU time used by the host are printed.
+ */
+
+#define DEFAULT_INSTANCES 100
+#define DEFAULT_SECONDS 10
+
+// maximum number of cycles executed by an emulator before yielding
+#define RUN_BUDGET 4096
+
+#define MAX_EVENTS 64
+
+struct instance_s {
+    CHIP8 chip8;
+    int timer;
+    uint64_t cycles;
+};
+
+typedef struct instance_s instance_t;
+
+static void run_instance(instance_t *instance);
+
+int main(int argc, char **argv) {
+    int instances = DEFAULT_INSTANCES;
+    int seconds = DEFAULT_SECONDS;
+    uint32_t clock_rate = DEFAULT_CLOCK_RATE;
+    int first = 1;
+
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-n")) {
+            instances = atoi(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-t")) {
+            seconds = atoi(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-r")) {
+            clock_rate = strtoul(argv[first + 1], NULL, 10);
+        } else {
+            break;
+        }
+
+        first += 2;
+    }
+
+    if (first + 1 != argc || instances <= 0 || clock_rate == 0) {
+        fprintf(stdout, "USAGE: ./chip8_host [-n instances] [-t seconds] [-r clock rate] /path/to/rom\n");
+        return 1;
+    }
+
+    // the emulators start on a cache line, like their hot state
+    instance_t *fleet = aligned_alloc(CHIP8_CACHE_LINE, instances * sizeof(instance_t));
+    int epoll = epoll_create1(0);
+
+    if (!fleet || epoll < 0) {
+        fprintf(stderr, "Unable to create the event loop! Aborting...\n");
+        return 1;
+    }
+
+    memset(fleet, 0, instances * sizeof(instance_t));
+
+    for (int i = 0; i < instances; i++) {
+        instance_t *instance = &fleet[i];
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = instance};
+
+        CHIP8_init(&instance->chip8);
+        CHIP8_load_rom_from_file(&instance->chip8, argv[first]);
+        CHIP8_set_clock_rate(&instance->chip8, clock_rate);
+
+        instance->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (instance->timer < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, instance->timer, &event)) {
+            fprintf(stderr, "Unable to create the timer of instance %d! Aborting...\n", i);
+            return 1;
+        }
+
+        run_instance(instance);
+    }
+
+    time_t end = time(NULL) + seconds;
+    while (time(NULL) < end) {
+        struct epoll_event events[MAX_EVENTS];
+        int ready = epoll_wait(epoll, events, MAX_EVENTS, 1000);
+
+        for (int i = 0; i < ready; i++) {
+            instance_t *instance = events[i].data.ptr;
+            uint64_t expirations;
+
+            read(instance->timer, &expirations, sizeof(expirations));
+            run_instance(instance);
+        }
+    }
+
+    uint64_t cycles = 0;
+    for (int i = 0; i < instances; i++) {
+        cycles += fleet[i].cycles;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+    fprintf(stdout, "%d instances, %d s: %llu cycles (%.0f per instance per second), %.2f s of CPU time\n",
+            instances, seconds, (unsigned long long) cycles, (double) cycles / instances / seconds, cpu);
+
+    return 0;
+}
+
+/**
+ * Run an emulator until its next deadline and arm its timer.
+ */
+static void run_instance(instance_t *instance) {
+    CHIP8_run_status status;
+
+    CHIP8_run(&instance->chip8, RUN_BUDGET, &status);
+    instance->cycles += status.cycles;
+
+    CHIP8_arm_timer(instance->timer, status.deadline);
+}
+
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "core/CHIP-8.h"
+#include "core/frame_buffer.h"
+#include "core/input_record.h"
+#include "core/profiler.h"
+#include "core/trace_buffer.h"
+
+/**
+ * Headless frontend: the emulator runs on the main thread and a sink
+ * thread consumes its frames at the refresh rate of a virtual display.
+ *
+ * Frames are handed over through a triple buffer, so the emulator
+ * never waits for the sink and the sink always gets the newest frame.
+ * The frames picked up by the sink are optionally written to a file
+ * as raw rows (VIDEO_HEIGHT big-endian 64-bit words per frame). At the
+ * end, the number of frames published, consumed and dropped is printed.
+ *
+ * A recorded session can be replayed instead: the emulator runs as fast
+ * as possible for the given emulated time, and the hash of its final
+ * state is printed, so that two runs can be compared.
+ *
+ * With -f, the emulator is profiled and the report is written to stderr
+ * at the end (the core must be compiled with -DCHIP8_PROFILE, see the
+ * 'profile' target).
+ *
+ * With -T, the last instructions executed are traced and written to the
+ * given file at the end, on a crash and on SIGUSR1 (see chip8_trace).
+ */
+
+#define DEFAULT_SECONDS 10
+#define DEFAULT_DISPLAY_RATE 60
+#define TRACE_ENTRIES (1 << 16)
+
+// maximum number of cycles executed by the emulator between two checks of the time
+#define RUN_BUDGET 4096
+
+static frame_buffer_t frame_buffer;
+
+static _Atomic int running = 1;
+
+static uint64_t published, dropped;
+
+struct sink_s {
+    FILE *output;
+    uint32_t display_rate;
+    uint64_t consumed;
+};
+
+typedef struct sink_s sink_t;
+
+static void publish_frame(const uint64_t *video);
+
+static void *sink_thread(void *arg);
+
+static void write_frame(FILE *output, const uint64_t *video);
+
+int main(int argc, char **argv) {
+    static CHIP8 chip8;
+    sink_t sink = {NULL, DEFAULT_DISPLAY_RATE, 0};
+    int seconds = DEFAULT_SECONDS;
+    uint32_t clock_rate = DEFAULT_CLOCK_RATE;
+    int turbo = 0;
+    int profile = 0;
+    const char *replay_path = NULL, *trace_path = NULL;
+    int first = 1;
+
+    while (first < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-u")) {
+            turbo = 1;
+            first += 1;
+            continue;
+        } else if (!strcmp(argv[first], "-f")) {
+            profile = 1;
+            first += 1;
+            continue;
+        } else if (first + 1 >= argc) {
+            break;
+        } else if (!strcmp(argv[first], "-t")) {
+            seconds = atoi(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-r")) {
+            clock_rate = strtoul(argv[first + 1], NULL, 10);
+        } else if (!strcmp(argv[first], "-d")) {
+            sink.display_rate = strtoul(argv[first + 1], NULL, 10);
+        } else if (!strcmp(argv[first], "-p")) {
+            replay_path = argv[first + 1];
+        } else if (!strcmp(argv[first], "-T")) {
+            trace_path = argv[first + 1];
+        } else if (!strcmp(argv[first], "-o")) {
+            if (!(sink.output = fopen(argv[first + 1], "wb"))) {
+                fprintf(stderr, "Unable to write the output file! Aborting...\n");
+                return 1;
+            }
+        } else {
+            break;
+        }
+
+        first += 2;
+    }
+
+    if (first + 1 != argc || clock_rate == 0 || sink.display_rate == 0) {
+        fprintf(stdout, "USAGE: ./chip8_sink [-t seconds] [-r clock rate] [-u] [-d display rate] "
+                        "[-o frames] [-p recording] [-f] [-T trace] /path/to/rom\n");
+        return 1;
+    }
+
+    CHIP8_init(&chip8);
+    CHIP8_load_rom_from_file(&chip8, argv[first]);
+    CHIP8_set_clock_rate(&chip8, clock_rate);
+    CHIP8_set_turbo(&chip8, turbo);
+    CHIP8_set_refresh_function(&chip8, &publish_frame);
+    CHIP8_set_present_mode(&chip8, CHIP8_PRESENT_VBLANK);
+
+    if (!CHIP8_set_profiling(&chip8, profile)) {
+        fprintf(stderr, "Unable to profile: the core is compiled without CHIP8_PROFILE! Aborting...\n");
+        return 1;
+    }
+
+    trace_buffer_t *trace = NULL;
+    if (trace_path) {
+        trace = trace_buffer_create(TRACE_ENTRIES);
+
+        if (!trace || !trace_buffer_dump_on_signal(trace, trace_path)) {
+            fprintf(stderr, "Unable to open the trace! Aborting...\n");
+            return 1;
+        }
+
+        CHIP8_set_trace(&chip8, trace);
+    }
+
+    input_record_t *replay = NULL;
+    if (replay_path && !(replay = input_record_open(replay_path, &chip8))) {
+        fprintf(stderr, "Unable to read the recording! Aborting...\n");
+        return 1;
+    }
+
+    frame_buffer_init(&frame_buffer);
+
+    pthread_t sink_id;
+    if (pthread_create(&sink_id, NULL, &sink_thread, &sink)) {
+        fprintf(stderr, "Unable to create the sink thread! Aborting...\n");
+        return 1;
+    }
+
+    uint64_t cycles = 0;
+    struct timespec now, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += seconds;
+    now = end;
+    now.tv_sec -= seconds;
+
+    if (replay) {
+        // the emulated time is replayed, not the wall clock time
+        uint64_t total = (uint64_t) seconds * chip8.clock_rate;
+
+        while (chip8.cycle_count < total) {
+            uint64_t left = total - chip8.cycle_count;
+            input_replay_run(replay, &chip8, left < RUN_BUDGET ? left : RUN_BUDGET);
+        }
+
+        cycles = chip8.cycle_count;
+    }
+
+    while (!replay && (now.tv_sec < end.tv_sec || (now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec))) {
+        CHIP8_run_status status;
+
+        CHIP8_run(&chip8, RUN_BUDGET, &status);
+        cycles += status.cycles;
+
+        if (status.deadline >= 0) {
+            struct timespec deadline = {status.deadline / 1000000000, status.deadline % 1000000000};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        } else {
+            // no key is ever pressed: the emulator is blocked for good
+            struct timespec second = {1, 0};
+            nanosleep(&second, NULL);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    atomic_store(&running, 0);
+    pthread_join(sink_id, NULL);
+
+    if (sink.output) {
+        fclose(sink.output);
+    }
+
+    fprintf(stdout, "%llu cycles, %llu frames published, %llu consumed, %llu dropped\n",
+            (unsigned long long) cycles, (unsigned long long) published,
+            (unsigned long long) sink.consumed, (unsigned long long) dropped);
+
+    if (profile) {
+        profile_report(&chip8, stderr);
+    }
+
+    // the trace is written by the handler of the dump signal
+    if (trace) {
+        raise(SIGUSR1);
+    }
+
+    if (replay) {
+        fprintf(stdout, "state hash %016llx\n", (unsigned long long) CHIP8_state_hash(&chip8));
+        input_record_close(replay);
+    }
+
+    return 0;
+}
+
+/**
+ * Hand a frame to the sink. Called by the emulator.
+ */
+static void publish_frame(const uint64_t *video) {
+    published++;
+    dropped += frame_buffer_publish(&frame_buffer, video);
+}
+
+/**
+ * Pick up the newest frame at every refresh of the virtual display.
+ */
+static void *sink_thread(void *arg) {
+    sink_t *sink = arg;
+    struct timespec next;
+    long period = 1000000000L / sink->display_rate;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (atomic_load(&running)) {
+        next.tv_nsec += period;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec += next.tv_nsec / 1000000000L;
+            next.tv_nsec %= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        const uint64_t *video = frame_buffer_acquire(&frame_buffer);
+        if (video) {
+            sink->consumed++;
+            write_frame(sink->output, video);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Write the rows of a frame as big-endian words.
+ */
+static void write_frame(FILE *output, const uint64_t *video) {
+    if (!output) {
+        return;
+    }
+
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            fputc((int) (video[y] >> shift) & 0xFF, output);
+        }
+    }
+}
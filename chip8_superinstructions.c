@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/CHIP-8.h"
+#include "core/superinstructions.h"
+
+/**
+ * Superinstruction selector: runs a set of ROMs, records how often
+ * each sequence of two and three instructions is executed without
+ * jumping, and writes the most frequent sequences as the list of
+ * superinstructions compiled into the emulator (core/superinstructions.def).
+ */
+
+#define DEFAULT_CYCLES 1000000
+#define DEFAULT_COUNT 8
+
+// the keyboard state changes every KEY_PERIOD cycles while profiling
+#define KEY_PERIOD 1000
+
+struct sequence_s {
+    uint8_t length;
+    uint8_t index[SUPERINSTRUCTION_MAX_LENGTH];
+    uint64_t executions;
+};
+
+typedef struct sequence_s sequence_t;
+
+static uint64_t pairs[ISA_SIZE][ISA_SIZE];
+static uint64_t triples[ISA_SIZE][ISA_SIZE][ISA_SIZE];
+
+// the emulator running the rom being profiled
+static CHIP8 profiled;
+
+static void profile_rom(const char *path, unsigned long cycles);
+
+static void keyboard_input(uint16_t *keys);
+
+static int compare_sequences(const void *a, const void *b);
+
+int main(int argc, char **argv) {
+    static CHIP8 chip8;
+    unsigned long cycles = DEFAULT_CYCLES;
+    int count = DEFAULT_COUNT;
+    int first = 1;
+
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-n")) {
+            cycles = strtoul(argv[first + 1], NULL, 10);
+        } else if (!strcmp(argv[first], "-k")) {
+            count = atoi(argv[first + 1]);
+        } else {
+            break;
+        }
+
+        first += 2;
+    }
+
+    if (first >= argc) {
+        fprintf(stdout, "USAGE: ./chip8_superinstructions [-n cycles] [-k count] /path/to/rom...\n");
+        return 1;
+    }
+
+    for (int i = first; i < argc; i++) {
+        profile_rom(argv[i], cycles);
+    }
+
+    // ISA entries are needed to name the sequences
+    CHIP8_init(&chip8);
+
+    static sequence_t sequences[ISA_SIZE * ISA_SIZE * (ISA_SIZE + 1)];
+    int n = 0;
+
+    for (int a = 0; a < ISA_SIZE; a++) {
+        for (int b = 0; b < ISA_SIZE; b++) {
+            if (pairs[a][b]) {
+                sequences[n++] = (sequence_t) {2, {a, b, 0}, pairs[a][b]};
+            }
+
+            for (int c = 0; c < ISA_SIZE; c++) {
+                if (triples[a][b][c]) {
+                    sequences[n++] = (sequence_t) {3, {a, b, c}, triples[a][b][c]};
+                }
+            }
+        }
+    }
+
+    qsort(sequences, n, sizeof(sequence_t), &compare_sequences);
+
+    fprintf(stdout, "/**\n"
+                    " * Superinstructions selected by chip8_superinstructions\n"
+                    " * (%lu cycles per rom, %d sequences) from the profile of:\n", cycles, count);
+    for (int i = first; i < argc; i++) {
+        fprintf(stdout, " *  - %s\n", argv[i]);
+    }
+    fprintf(stdout, " *\n * Regenerate with 'make superinstructions ROMS=\"...\"'.\n */\n\n");
+
+    for (int i = 0; i < n && i < count; i++) {
+        fprintf(stdout, "SUPERINSTRUCTION_%d(", sequences[i].length);
+
+        for (int j = 0; j < sequences[i].length; j++) {
+            fprintf(stdout, "%s%s", j ? ", " : "", chip8.ISA[sequences[i].index[j]].name);
+        }
+
+        fprintf(stdout, ") // %llu executions\n", (unsigned long long) sequences[i].executions);
+    }
+
+    return 0;
+}
+
+/**
+ * Run a rom with the interpreter and count the sequences it executes.
+ * A sequence is counted when each of its instructions, except the last
+ * one, continues to the next address and is allowed in a superinstruction.
+ *
+ * The rom runs with CHIP8_step, as in the emulator: the iterations of the
+ * idle loops fast-forwarded by the step are never dispatched, so they are
+ * not counted.
+ */
+static void profile_rom(const char *path, unsigned long cycles) {
+    CHIP8 *chip8 = &profiled;
+    int previous[2] = {-1, -1};
+    uint16_t expected = 0;
+
+    CHIP8_init(chip8);
+    CHIP8_load_rom_from_file(chip8, (char *) path);
+    CHIP8_set_keyboard_input_function(chip8, &keyboard_input);
+    CHIP8_set_seed(chip8, 0);
+
+    while (chip8->cycle_count < cycles) {
+        uint16_t opcode = (chip8->memory[chip8->PC] << 8) | chip8->memory[chip8->PC + 1];
+        const instruction_t *instruction = CHIP8_decode_instruction(chip8, opcode);
+        int index = instruction != NULL && !chip8->waiting_key ? (int) (instruction - chip8->ISA) : -1;
+
+        // the sequence is broken by jumps, taken skips, key waits and unknown opcodes
+        if (chip8->PC != expected || index < 0) {
+            previous[0] = previous[1] = -1;
+        }
+
+        expected = chip8->PC + 2;
+
+        // an idle loop skip executes no instruction
+        if (CHIP8_step(chip8) > 1) {
+            previous[0] = previous[1] = -1;
+            continue;
+        }
+
+        if (index >= 0 && previous[1] >= 0) {
+            pairs[previous[1]][index]++;
+
+            if (previous[0] >= 0) {
+                triples[previous[0]][previous[1]][index]++;
+            }
+        }
+
+        previous[0] = previous[1];
+        previous[1] = index >= 0 && superinstruction_can_continue(instruction->execute) ? index : -1;
+        if (previous[1] < 0) {
+            previous[0] = -1;
+        }
+    }
+}
+
+/**
+ * Press and release keys in a fixed pattern, so that
+ * the input handling code of the rom is profiled too.
+ */
+static void keyboard_input(uint16_t *keys) {
+    // called at the end of the cycle, which is already counted
+    uint64_t cycle = profiled.cycle_count - 1;
+
+    if (cycle % KEY_PERIOD == 0) {
+        *keys ^= 1 << ((cycle / KEY_PERIOD) % NUM_KEYS);
+    }
+}
+
+/**
+ * Order the sequences by the number of dispatches they save
+ */
+static int compare_sequences(const void *a, const void *b) {
+    const sequence_t *sa = a, *sb = b;
+    uint64_t saved_a = sa->executions * (sa->length - 1);
+    uint64_t saved_b = sb->executions * (sb->length - 1);
+
+    return saved_a < saved_b ? 1 : saved_a > saved_b ? -1 : 0;
+}
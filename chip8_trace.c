@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/trace_buffer.h"
+#include "core/assembler.h"
+
+/**
+ * Trace decoder: prints a trace written by the tracer (see trace_buffer.h),
+ * one instruction per line, from the oldest to the newest:
+ *
+ *     cycle      PC     opcode  instruction          I      changed
+ *     1048576    0x2A4  D01F    DRW V0, V1, 15       0x2EA  VF=0x00
+ *
+ * The changed column shows the first register written by the instruction
+ * with its new value, followed by VF if the flag changed too. The cycles
+ * in which no instruction was recorded (idle loops fast-forwarded, waits
+ * for a key) are reported between the instructions.
+ */
+
+#define HEADER_SIZE 24
+
+int main(int argc, char **argv) {
+    unsigned long last = 0;
+    int first = 1;
+
+    if (argc == 4 && !strcmp(argv[1], "-n")) {
+        last = strtoul(argv[2], NULL, 10);
+        first = 3;
+    }
+
+    if (first + 1 != argc) {
+        fprintf(stdout, "USAGE: ./chip8_trace [-n last instructions] trace\n");
+        return 1;
+    }
+
+    FILE *file = fopen(argv[first], "rb");
+    uint8_t header[HEADER_SIZE];
+
+    if (!file || fread(header, 1, HEADER_SIZE, file) != HEADER_SIZE) {
+        fprintf(stderr, "Unable to read the trace! Aborting...\n");
+        return 1;
+    }
+
+    if (memcmp(header, TRACE_MAGIC, 4) || header[4] != TRACE_VERSION) {
+        fprintf(stderr, "Not a trace (or an unsupported version)! Aborting...\n");
+        return 1;
+    }
+
+    uint32_t count;
+    uint64_t last_cycle;
+
+    memcpy(&count, header + 8, 4);
+    memcpy(&last_cycle, header + 16, 8);
+
+    trace_entry_t *entries = malloc((count ? count : 1) * sizeof(trace_entry_t));
+
+    if (!entries || fread(entries, sizeof(trace_entry_t), count, file) != count) {
+        fprintf(stderr, "Unable to read the trace! Aborting...\n");
+        return 1;
+    }
+
+    fclose(file);
+
+    uint32_t start = last && last < count ? count - (uint32_t) last : 0;
+    uint32_t newest = count ? entries[count - 1].cycle : 0;
+    uint64_t previous = 0;
+
+    fprintf(stdout, "Trace: %u instructions\n\n", count - start);
+    fprintf(stdout, "%-12s %-6s %-7s %-20s %-6s %s\n", "cycle", "PC", "opcode", "instruction", "I", "changed");
+
+    for (uint32_t i = start; i < count; i++) {
+        const trace_entry_t *entry = &entries[i];
+
+        // the cycles only keep their low 32 bits, the newest one is complete
+        uint64_t cycle = last_cycle - (uint32_t) (newest - entry->cycle);
+        char text[32], changed[16] = "";
+
+        if (i > start && cycle > previous + 1) {
+            fprintf(stdout, "... %llu cycles without instructions\n", (unsigned long long) (cycle - previous - 1));
+        }
+
+        disassemble_instruction(entry->opcode, text, sizeof(text));
+
+        if (entry->reg != TRACE_NO_REGISTER) {
+            snprintf(changed, sizeof(changed), "V%X=0x%02X%s", entry->reg & 0xF, entry->value,
+                     entry->reg & TRACE_FLAG_CHANGED ? " VF" : "");
+        }
+
+        fprintf(stdout, "%-12llu 0x%03X  %04X    %-20s 0x%03X  %s\n", (unsigned long long) cycle,
+                entry->PC, entry->opcode, text, entry->I, changed);
+
+        previous = cycle;
+    }
+
+    free(entries);
+    return 0;
+}
\ No newline at end of file
@@ -24,21 +24,37 @@ const uint8_t pong[] =
                 0x6b, 0x20, 0xdb, 0xa1, 0x00, 0xee
         };
 
-void refresh_screen(const uint8_t *video);
+/**
+ * app.js executes one instruction every 4 ms (PERIOD): the timers
+ * count down at TIMER_RATE only if the core knows the clock rate.
+ */
+#define WEB_CLOCK_RATE 250
+
+void refresh_screen(const uint64_t *video, uint32_t dirty_rows, const uint64_t *damage);
 
 void emit_beep();
 
-void keyboard_input(uint8_t *keyboard);
+int key_index(char key);
 
 CHIP8 chip8;
 
+/**
+ * Byte per pixel copy of the video memory read by app.js
+ */
+uint8_t pixels[VIDEO_SIZE];
+
+/**
+ * Rows changed since app.js last read the video memory
+ */
+uint32_t dirty;
+
 EMSCRIPTEN_KEEPALIVE int CHIP8_wasm_initialize() {
     CHIP8_init(&chip8);
     CHIP8_load_rom_bytes(&chip8, (uint8_t *) &pong, sizeof(pong));
+    CHIP8_set_clock_rate(&chip8, WEB_CLOCK_RATE);
 
-    CHIP8_set_refresh_function(&chip8, &refresh_screen);
+    CHIP8_set_refresh_damage_function(&chip8, &refresh_screen);
     CHIP8_set_beep_function(&chip8, &emit_beep);
-    CHIP8_set_keyboard_input_function(&chip8, &keyboard_input);
 
     return 0;
 }
@@ -49,7 +65,15 @@ EMSCRIPTEN_KEEPALIVE int CHIP8_wasm_tick() {
 }
 
 EMSCRIPTEN_KEEPALIVE void *CHIP8_wasm_get_video() {
-    return chip8.video;
+    CHIP8_video_to_bytes(chip8.video, pixels);
+    return pixels;
+}
+
+EMSCRIPTEN_KEEPALIVE unsigned CHIP8_wasm_get_dirty_rows() {
+    uint32_t rows = dirty;
+
+    dirty = 0;
+    return rows;
 }
 
 EMSCRIPTEN_KEEPALIVE int CHIP8_wasm_get_PC() {
@@ -61,57 +85,54 @@ EMSCRIPTEN_KEEPALIVE void *CHIP8_wasm_get_register_file() {
 }
 
 EMSCRIPTEN_KEEPALIVE void CHIP8_wasm_set_key_down(char key) {
-    if (key == '1') chip8.key[0x1] = 1;
-    else if (key == '2') chip8.key[0x2] = 1;
-    else if (key == '3') chip8.key[0x3] = 1;
-    else if (key == '4') chip8.key[0xC] = 1;
-
-    else if (key == 'q') chip8.key[0x4] = 1;
-    else if (key == 'w') chip8.key[0x5] = 1;
-    else if (key == 'e') chip8.key[0x6] = 1;
-    else if (key == 'r') chip8.key[0xD] = 1;
-
-    else if (key == 'a') chip8.key[0x7] = 1;
-    else if (key == 's') chip8.key[0x8] = 1;
-    else if (key == 'd') chip8.key[0x9] = 1;
-    else if (key == 'f') chip8.key[0xE] = 1;
-
-    else if (key == 'z') chip8.key[0xA] = 1;
-    else if (key == 'x') chip8.key[0x0] = 1;
-    else if (key == 'c') chip8.key[0xB] = 1;
-    else if (key == 'v') chip8.key[0xF] = 1;
+    int index = key_index(key);
+
+    if (index >= 0) {
+        CHIP8_key_event(&chip8, index, 1);
+    }
 }
 
 EMSCRIPTEN_KEEPALIVE void CHIP8_wasm_set_key_up(char key) {
-    if (key == '1') chip8.key[0x1] = 0;
-    else if (key == '2') chip8.key[0x2] = 0;
-    else if (key == '3') chip8.key[0x3] = 0;
-    else if (key == '4') chip8.key[0xC] = 0;
-
-    else if (key == 'q') chip8.key[0x4] = 0;
-    else if (key == 'w') chip8.key[0x5] = 0;
-    else if (key == 'e') chip8.key[0x6] = 0;
-    else if (key == 'r') chip8.key[0xD] = 0;
-
-    else if (key == 'a') chip8.key[0x7] = 0;
-    else if (key == 's') chip8.key[0x8] = 0;
-    else if (key == 'd') chip8.key[0x9] = 0;
-    else if (key == 'f') chip8.key[0xE] = 0;
-
-    else if (key == 'z') chip8.key[0xA] = 0;
-    else if (key == 'x') chip8.key[0x0] = 0;
-    else if (key == 'c') chip8.key[0xB] = 0;
-    else if (key == 'v') chip8.key[0xF] = 0;
+    int index = key_index(key);
+
+    if (index >= 0) {
+        CHIP8_key_event(&chip8, index, 0);
+    }
 }
 
-void refresh_screen(const uint8_t *video) {
-    // do nothing
+/**
+ * Map a key of the physical keyboard to the CHIP8 keypad
+ *
+ * @return the index of the CHIP8 key, or -1 if the key is not mapped
+ */
+int key_index(char key) {
+    if (key == '1') return 0x1;
+    else if (key == '2') return 0x2;
+    else if (key == '3') return 0x3;
+    else if (key == '4') return 0xC;
+
+    else if (key == 'q') return 0x4;
+    else if (key == 'w') return 0x5;
+    else if (key == 'e') return 0x6;
+    else if (key == 'r') return 0xD;
+
+    else if (key == 'a') return 0x7;
+    else if (key == 's') return 0x8;
+    else if (key == 'd') return 0x9;
+    else if (key == 'f') return 0xE;
+
+    else if (key == 'z') return 0xA;
+    else if (key == 'x') return 0x0;
+    else if (key == 'c') return 0xB;
+    else if (key == 'v') return 0xF;
+
+    return -1;
 }
 
-void emit_beep() {
-    // do nothing
+void refresh_screen(const uint64_t *video, uint32_t dirty_rows, const uint64_t *damage) {
+    dirty |= dirty_rows;
 }
 
-void keyboard_input(uint8_t *keyboard) {
+void emit_beep() {
     // do nothing
 }
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "core/CHIP-8.h"
+#include "core/assembler.h"
+
+/**
+ * Workload generator: writes synthetic ROMs that stress a single part
+ * of the emulator, so that every engine and hot path can be measured
+ * on its own (see chip8_bench). Every workload loops forever and takes
+ * a size parameter:
+ *  - draw: sprite blitting over the whole screen (sprite height, 1-15)
+ *  - alu: a chain of arithmetic and logic instructions (chain length)
+ *  - calls: nested calls and returns (call depth, 1-16)
+ *  - memory: Fx55/Fx65 register traffic (registers moved, 1-14)
+ *  - timer: busy-waits on the delay timer (delay in frames, 1-255)
+ *  - smc: self-modifying code (instructions patched per iteration)
+ *
+ * The workloads are written in assembly and translated by the assembler
+ * in core/assembler.c, which can also assemble a source file (-a).
+ */
+
+#define MAX_SOURCE_SIZE (64 * 1024)
+
+struct workload_s {
+    const char *name;
+    int default_size;
+    int min_size;
+    int max_size;
+
+    void (*generate)(int size);
+};
+
+typedef struct workload_s workload_t;
+
+static char source[MAX_SOURCE_SIZE];
+static size_t source_length;
+
+static void generate_draw(int size);
+
+static void generate_alu(int size);
+
+static void generate_calls(int size);
+
+static void generate_memory(int size);
+
+static void generate_timer(int size);
+
+static void generate_smc(int size);
+
+static const workload_t workloads[] = {
+        {"draw",   15,  1, 15,   &generate_draw},
+        {"alu",    64,  1, 1024, &generate_alu},
+        {"calls",  16,  1, 16,   &generate_calls},
+        {"memory", 14,  1, 14,   &generate_memory},
+        {"timer",  2,   1, 255,  &generate_timer},
+        {"smc",    4,   1, 64,   &generate_smc},
+};
+
+#define NUM_WORKLOADS (sizeof(workloads) / sizeof(workloads[0]))
+
+static void line(const char *format, ...);
+
+static int read_source(const char *path);
+
+static int write_rom(const char *path);
+
+int main(int argc, char **argv) {
+    int size = -1;
+    int assemble = 0;
+    int first = 1;
+
+    while (first < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-a")) {
+            assemble = 1;
+            first += 1;
+        } else if (!strcmp(argv[first], "-n") && first + 1 < argc) {
+            size = atoi(argv[first + 1]);
+            first += 2;
+        } else {
+            break;
+        }
+    }
+
+    const workload_t *workload = NULL;
+    for (size_t i = 0; i < NUM_WORKLOADS && first < argc; i++) {
+        if (!strcmp(argv[first], workloads[i].name)) {
+            workload = &workloads[i];
+        }
+    }
+
+    if (first + 2 != argc || (!assemble && workload == NULL)
+        || (workload != NULL && size != -1 && (size < workload->min_size || size > workload->max_size))) {
+        fprintf(stdout, "USAGE: ./chip8_workloads [-n size] draw|alu|calls|memory|timer|smc output.c8\n"
+                        "       ./chip8_workloads -a source.asm output.c8\n");
+        return 1;
+    }
+
+    if (assemble) {
+        if (!read_source(argv[first])) {
+            fprintf(stderr, "Unable to read the source file! Aborting...\n");
+            return 1;
+        }
+    } else {
+        workload->generate(size != -1 ? size : workload->default_size);
+    }
+
+    return write_rom(argv[first + 1]) ? 0 : 1;
+}
+
+/**
+ * Sprites drawn in rows of 8 pixel wide columns, moving down the screen
+ * at every pass. The sprite has the given height.
+ */
+static void generate_draw(int size) {
+    line("; draw: %d rows high sprites over the whole screen", size);
+    line("    LD V2, 0x1F");
+    line("    LD I, sprite");
+    line("row:");
+    line("    LD V0, 0");
+    line("column:");
+    line("    DRW V0, V1, %d", size);
+    line("    ADD V0, 8");
+    line("    SE V0, 64");
+    line("    JP column");
+    line("    ADD V1, %d", size);
+    line("    AND V1, V2");
+    line("    JP row");
+    line("sprite:");
+
+    for (int i = 0; i < size; i++) {
+        line("    db 0b%d%d%d%d%d%d%d%d", 1, i & 1, 1, !(i & 1), 1, i & 1, 1, !(i & 1));
+    }
+}
+
+/**
+ * A chain of register to register and immediate ALU instructions,
+ * picked in a fixed pseudorandom order over V0-VE.
+ */
+static void generate_alu(int size) {
+    static const char *register_ops[] = {"ADD", "OR", "AND", "XOR", "SUB", "SUBN", "SHR", "SHL", "LD"};
+    uint32_t state = 1;
+
+    line("; alu: %d instructions", size);
+    for (int x = 0; x < 15; x++) {
+        line("    LD V%X, %d", x, 17 * x + 3);
+    }
+
+    line("loop:");
+    for (int i = 0; i < size; i++) {
+        state = state * 1103515245 + 12345;
+
+        int op = (state >> 16) % 11;
+        int x = (state >> 8) % 15, y = (state >> 4) % 15;
+
+        if (op < 9) {
+            line("    %s V%X, V%X", register_ops[op], x, y);
+        } else {
+            line("    %s V%X, %d", op == 9 ? "ADD" : "RND", x, (state >> 20) & 0xFF);
+        }
+    }
+    line("    JP loop");
+}
+
+/**
+ * A chain of subroutines, each calling the next one, with the given depth
+ */
+static void generate_calls(int size) {
+    line("; calls: %d nested calls", size);
+    line("loop:");
+    line("    CALL function1");
+    line("    JP loop");
+
+    for (int depth = 1; depth <= size; depth++) {
+        line("function%d:", depth);
+        line("    ADD V%X, 1", depth % 15);
+
+        if (depth < size) {
+            line("    CALL function%d", depth + 1);
+        }
+
+        line("    RET");
+    }
+}
+
+/**
+ * The registers are stored to a 256 bytes buffer, at an offset moving
+ * by 16 bytes at every iteration, and loaded back from its start.
+ * VE holds the offset, so at most V0-VD are moved.
+ */
+static void generate_memory(int size) {
+    line("; memory: V0-V%X stored and loaded", size - 1);
+    line("loop:");
+    line("    LD I, buffer");
+    line("    ADD I, VE");
+    line("    LD [I], V%X", size - 1);
+    line("    LD I, buffer");
+    line("    LD V%X, [I]", size - 1);
+    line("    ADD V0, 1");
+    line("    ADD VE, 16");
+    line("    JP loop");
+    line("buffer:");
+
+    for (int i = 0; i < 256 + 16; i += 16) {
+        line("    db 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0");
+    }
+}
+
+/**
+ * The delay timer is set and polled until it expires, as games
+ * do to pace their frames
+ */
+static void generate_timer(int size) {
+    line("; timer: waits of %d frames", size);
+    line("loop:");
+    line("    LD V0, %d", size);
+    line("    LD DT, V0");
+    line("wait:");
+    line("    LD V1, DT");
+    line("    SE V1, 0");
+    line("    JP wait");
+    line("    ADD V2, 1");
+    line("    JP loop");
+}
+
+/**
+ * Every iteration rewrites the immediate of the given number of
+ * instructions, which are executed right after
+ */
+static void generate_smc(int size) {
+    line("; smc: %d instructions patched per iteration", size);
+    line("loop:");
+    line("    ADD V1, 1");
+    line("    LD V0, V1");
+
+    for (int i = 0; i < size; i++) {
+        line("    LD I, patch%d+1", i);
+        line("    LD [I], V0");
+    }
+
+    for (int i = 0; i < size; i++) {
+        line("patch%d:", i);
+        line("    ADD V%X, 0", 2 + i % 13);
+    }
+
+    line("    JP loop");
+}
+
+/**
+ * Append a formatted line to the source
+ */
+static void line(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(source + source_length, sizeof(source) - source_length, format, args);
+    va_end(args);
+
+    if (length < 0 || source_length + length + 1 >= sizeof(source)) {
+        fprintf(stderr, "The workload is too large! Aborting...\n");
+        exit(1);
+    }
+
+    source_length += length;
+    source[source_length++] = '\n';
+    source[source_length] = '\0';
+}
+
+/**
+ * Load an assembly source file
+ */
+static int read_source(const char *path) {
+    FILE *file = fopen(path, "r");
+
+    if (!file) {
+        return 0;
+    }
+
+    source_length = fread(source, 1, sizeof(source) - 1, file);
+    source[source_length] = '\0';
+
+    int complete = feof(file);
+    fclose(file);
+
+    return complete;
+}
+
+/**
+ * Assemble the source and write the program
+ */
+static int write_rom(const char *path) {
+    static uint8_t program[ASSEMBLER_MAX_SIZE];
+    int size = assemble_program(source, program, sizeof(program));
+
+    if (size < 0) {
+        return 0;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(program, 1, size, file) != (size_t) size) {
+        fprintf(stderr, "Unable to write the rom! Aborting...\n");
+        return 0;
+    }
+
+    fclose(file);
+
+    return 1;
+}
@@ -1,12 +1,77 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <stddef.h>
 
 #include "CHIP-8.h"
 #include "instructions.h"
+#include "block_cache.h"
+#include "jit.h"
+#include "idle_loop.h"
+#include "input_record.h"
+#include "profiler.h"
+#include "trace_buffer.h"
+#include "endian_io.h"
+
+#if CHIP8_TIMERFD
+#include <sys/timerfd.h>
+#endif
 
+/**
+ * Profiler hooks: compiled out unless CHIP8_PROFILE is defined,
+ * and a single test of the profile pointer otherwise
+ */
+#ifdef CHIP8_PROFILE
+#define PROFILING(chip8) ((chip8)->profile != NULL)
+#define PROFILE(chip8, hook) do { if (PROFILING(chip8)) { hook; } } while (0)
+#else
+#define PROFILING(chip8) 0
+#define PROFILE(chip8, hook) do { } while (0)
+#endif
+
+/**
+ * Tracer hooks: always compiled, a test of the trace pointer around each instruction
+ */
+#define TRACE_BEGIN(chip8) do { if ((chip8)->trace != NULL) { trace_begin((chip8)->trace, chip8); } } while (0)
+#define TRACE_END(chip8, address, opcode) \
+    do { if ((chip8)->trace != NULL) { trace_end((chip8)->trace, chip8, address, opcode); } } while (0)
+
+/**
+ * An instrumented emulator executes its instructions one at a time
+ */
+#define INSTRUMENTED(chip8) (PROFILING(chip8) || (chip8)->trace != NULL)
+
+/**
+ * Maximum delay of CHIP8_run with respect to the clock, in nanoseconds:
+ * longer delays are not recovered by running faster.
+ */
+#define MAX_LAG (100 * 1000 * 1000)
 
-#define CLK_PERIOD (2 * 1000)
+/**
+ * Save states: magic number at the start of an image, and size of
+ * the chunks of memory compared with the image on restore
+ */
+#define STATE_MAGIC "C8ST"
+#define STATE_CHUNK_SIZE 64
+
+/**
+ * Layout of a save state image. The header (magic, version and
+ * padding) takes 8 bytes, so that memory and video are aligned.
+ */
+#define STATE_MEMORY 8
+#define STATE_VIDEO (STATE_MEMORY + 4096)
+#define STATE_REGISTERS (STATE_VIDEO + 8 * VIDEO_HEIGHT)
+#define STATE_I (STATE_REGISTERS + 16)
+#define STATE_PC (STATE_I + 2)
+#define STATE_SP (STATE_PC + 2)
+#define STATE_STACK (STATE_SP + 1)
+#define STATE_TIMERS (STATE_STACK + 2 * 16)
+#define STATE_CLOCK (STATE_TIMERS + 2)
+#define STATE_KEYS (STATE_CLOCK + 8)
+#define STATE_RANDOM (STATE_KEYS + 6)
 
 uint8_t fontset[FONTSET_SIZE] =
         {
@@ -28,12 +93,37 @@ uint8_t fontset[FONTSET_SIZE] =
                 0xF0, 0x80, 0xF0, 0x80, 0x80  // F
         };
 
-static void define_instruction(CHIP8 *chip8, int index,
-                               uint16_t mask, uint16_t opcode,
-                               void (*execute)(CHIP8 *, uint16_t));
-
 void load_ISA(CHIP8 *chip8);
 
+static void build_decode_table();
+
+static void resume_key_wait(CHIP8 *chip8);
+
+static void advance_timers(CHIP8 *chip8, uint64_t cycles);
+
+static void update_timers(CHIP8 *chip8, int updates);
+
+static void present_frame(CHIP8 *chip8);
+
+static uint64_t ns_to_cycles(CHIP8 *chip8, int64_t ns);
+
+static int64_t cycles_to_ns(CHIP8 *chip8, uint64_t cycles);
+
+/**
+ * Opcode to ISA index map, built from the ISA by build_decode_table.
+ * Opcodes that do not match any instruction map to ISA_SIZE.
+ *
+ * The table is shared by all the emulators and built once, by the first
+ * CHIP8_init: decode_state goes from 0 (not built) to 1 (being built)
+ * to 2 (built), so that emulators can be created from several threads.
+ */
+static uint8_t decode_table[0x10000];
+static atomic_int decode_state;
+
+// the state used by every instruction must fit the first cache line (see CHIP8_s)
+_Static_assert(offsetof(CHIP8, random_state) + sizeof(uint64_t) <= CHIP8_CACHE_LINE,
+               "the hot CPU state does not fit a cache line");
+
 
 /**
  * Initialize the CHIP8 emulator and load the provided rom in main memory.
@@ -42,74 +132,116 @@ void load_ISA(CHIP8 *chip8);
  * @param rom is the path of the rom
  */
 void CHIP8_init(CHIP8 *chip8) {
-    srand((unsigned) getpid());
+    // registers, stack, memory and screen start from zero, whatever the storage held
+    memset(chip8, 0, sizeof(CHIP8));
+
+    CHIP8_set_seed(chip8, (uint64_t) getpid());
 
     // reset current instruction
     chip8->PC = MEMORY_PGM_START;
 
-    chip8->SP = 0;
-    chip8->I = 0;
-    chip8->sound_timer = 0;
-    chip8->delay_timer = 0;
+    chip8->clock_rate = DEFAULT_CLOCK_RATE;
+    chip8->run_start = -1;
 
     // load the instruction set
     load_ISA(chip8);
 
-    // clear the screen state
-    memset(chip8->video, 0, 64 * 32);
-
-    // clear the keyboard state
-    memset(chip8->key, 0, 16);
+    chip8->present_mode = CHIP8_PRESENT_IMMEDIATE;
 
     // set the fontset
     memcpy(chip8->memory + MEMORY_FONTSET_START, fontset, FONTSET_SIZE);
-
-    chip8->refresh_screen = NULL;
-    chip8->beep = NULL;
-    chip8->keyboard_input = NULL;
 }
 
+/**
+ * Instruction set, shared by all the emulators.
+ * The entries are indexed by the values of decode_table.
+ */
+static const instruction_t instruction_set[ISA_SIZE] = {
+        {0xF000, 0x0000, &sys, "sys"},
+        {0xFFFF, 0x00E0, &clear_screen, "clear_screen"},
+        {0xFFFF, 0x00EE, &ret, "ret"},
+        {0xF000, 0x1000, &jump_immediate, "jump_immediate"},
+        {0xF000, 0x2000, &call, "call"},
+        {0xF000, 0x3000, &skip_equal_imm, "skip_equal_imm"},
+        {0xF000, 0x4000, &skip_not_equal_imm, "skip_not_equal_imm"},
+        {0xF00F, 0x5000, &skip_equal_reg, "skip_equal_reg"},
+        {0xF000, 0x6000, &load_immediate, "load_immediate"},
+        {0xF000, 0x7000, &add_immediate, "add_immediate"},
+        {0xF00F, 0x8000, &mov, "mov"},
+        {0xF00F, 0x8001, &or, "or"},
+        {0xF00F, 0x8002, &and, "and"},
+        {0xF00F, 0x8003, &xor, "xor"},
+        {0xF00F, 0x8004, &add_reg, "add_reg"},
+        {0xF00F, 0x8005, &sub, "sub"},
+        {0xF00F, 0x8006, &shift_right, "shift_right"},
+        {0xF00F, 0x8007, &subn, "subn"},
+        {0xF00F, 0x800E, &shift_left, "shift_left"},
+        {0xF00F, 0x9000, &skip_ne_reg, "skip_ne_reg"},
+        {0xF000, 0xA000, &load_index, "load_index"},
+        {0xF000, 0xB000, &jump_addr, "jump_addr"},
+        {0xF000, 0xC000, &rnd, "rnd"},
+        {0xF000, 0xD000, &draw, "draw"},
+        {0xF0FF, 0xE09E, &skip_if_pressed, "skip_if_pressed"},
+        {0xF0FF, 0xE0A1, &skip_if_not_pressed, "skip_if_not_pressed"},
+        {0xF0FF, 0xF007, &load_timer_value, "load_timer_value"},
+        {0xF0FF, 0xF00A, &load_key, "load_key"},
+        {0xF0FF, 0xF015, &set_timer_value, "set_timer_value"},
+        {0xF0FF, 0xF018, &set_sound_value, "set_sound_value"},
+        {0xF0FF, 0xF01E, &add_to_index, "add_to_index"},
+        {0xF0FF, 0xF029, &load_sprite_location, "load_sprite_location"},
+        {0xF0FF, 0xF033, &load_bcd_representation, "load_bcd_representation"},
+        {0xF0FF, 0xF055, &store_registers, "store_registers"},
+        {0xF0FF, 0xF065, &load_registers, "load_registers"}
+};
+
 /**
  * Initialize the instruction set.
- * Each instruction is associated to an entry of the CHIP8-ISA array.
+ * Each emulator points to the shared instruction_set array, and the
+ * first one builds the decode table.
  * @param chip8 is a pointer to the CHIP8 struct
  */
 void load_ISA(CHIP8 *chip8) {
-    define_instruction(chip8, 0, 0xF000, 0x0000, &sys);
-    define_instruction(chip8, 1, 0xFFFF, 0x00E0, &clear_screen);
-    define_instruction(chip8, 2, 0xFFFF, 0x00EE, &ret);
-    define_instruction(chip8, 3, 0xF000, 0x1000, &jump_immediate);
-    define_instruction(chip8, 4, 0xF000, 0x2000, &call);
-    define_instruction(chip8, 5, 0xF000, 0x3000, &skip_equal_imm);
-    define_instruction(chip8, 6, 0xF000, 0x4000, &skip_not_equal_imm);
-    define_instruction(chip8, 7, 0xF00F, 0x5000, &skip_equal_reg);
-    define_instruction(chip8, 8, 0xF000, 0x6000, &load_immediate);
-    define_instruction(chip8, 9, 0xF000, 0x7000, &add_immediate);
-    define_instruction(chip8, 10, 0xF00F, 0x8000, &mov);
-    define_instruction(chip8, 11, 0xF00F, 0x8001, &or);
-    define_instruction(chip8, 12, 0xF00F, 0x8002, &and);
-    define_instruction(chip8, 13, 0xF00F, 0x8003, &xor);
-    define_instruction(chip8, 14, 0xF00F, 0x8004, &add_reg);
-    define_instruction(chip8, 15, 0xF00F, 0x8005, &sub);
-    define_instruction(chip8, 16, 0xF00F, 0x8006, &shift_right);
-    define_instruction(chip8, 17, 0xF00F, 0x8007, &subn);
-    define_instruction(chip8, 18, 0xF00F, 0x800E, &shift_left);
-    define_instruction(chip8, 19, 0xF00F, 0x9000, &skip_ne_reg);
-    define_instruction(chip8, 20, 0xF000, 0xA000, &load_index);
-    define_instruction(chip8, 21, 0xF000, 0xB000, &jump_addr);
-    define_instruction(chip8, 22, 0xF000, 0xC000, &rnd);
-    define_instruction(chip8, 23, 0xF000, 0xD000, &draw);
-    define_instruction(chip8, 24, 0xF0FF, 0xE09E, &skip_if_pressed);
-    define_instruction(chip8, 25, 0xF0FF, 0xE0A1, &skip_if_not_pressed);
-    define_instruction(chip8, 26, 0xF0FF, 0xF007, &load_timer_value);
-    define_instruction(chip8, 27, 0xF0FF, 0xF00A, &load_key);
-    define_instruction(chip8, 28, 0xF0FF, 0xF015, &set_timer_value);
-    define_instruction(chip8, 29, 0xF0FF, 0xF018, &set_sound_value);
-    define_instruction(chip8, 30, 0xF0FF, 0xF01E, &add_to_index);
-    define_instruction(chip8, 31, 0xF0FF, 0xF029, &load_sprite_location);
-    define_instruction(chip8, 32, 0xF0FF, 0xF033, &load_bcd_representation);
-    define_instruction(chip8, 33, 0xF0FF, 0xF055, &store_registers);
-    define_instruction(chip8, 34, 0xF0FF, 0xF065, &load_registers);
+    chip8->ISA = instruction_set;
+
+    int state = 0;
+
+    if (atomic_compare_exchange_strong(&decode_state, &state, 1)) {
+        build_decode_table();
+        atomic_store(&decode_state, 2);
+    }
+
+    // another thread may be building the table
+    while (atomic_load(&decode_state) != 2);
+}
+
+/**
+ * Precompute, for every possible opcode, the index of the ISA entry
+ * that executes it, so that CHIP8_tick can decode in constant time.
+ *
+ * An opcode may match more than one entry: 00E0 and 00EE also match
+ * sys (0nnn). In that case the entry with the most specific mask wins;
+ * this is equivalent to running every match since sys is a no-op.
+ */
+static void build_decode_table() {
+    memset(decode_table, ISA_SIZE, sizeof(decode_table));
+
+    for (uint8_t i = 0; i < ISA_SIZE; i++) {
+        uint16_t mask = instruction_set[i].mask;
+        uint16_t free_bits = ~mask;
+
+        // enumerate every opcode that matches the instruction
+        uint16_t operands = free_bits;
+        do {
+            uint16_t opcode = instruction_set[i].opcode | operands;
+            uint8_t match = decode_table[opcode];
+
+            if (match == ISA_SIZE || mask > instruction_set[match].mask) {
+                decode_table[opcode] = i;
+            }
+
+            operands = (operands - 1) & free_bits;
+        } while (operands != free_bits);
+    }
 }
 
 void CHIP8_load_rom_from_file(CHIP8 *chip8, char *path) {
@@ -126,29 +258,363 @@ void CHIP8_load_rom_from_file(CHIP8 *chip8, char *path) {
     }
 
     fclose(rom);
+
+    CHIP8_memory_written(chip8, MEMORY_PGM_START, i);
 }
 
 void CHIP8_load_rom_bytes(CHIP8 *chip8, uint8_t *rom, int length) {
     memcpy(chip8->memory + MEMORY_PGM_START, rom, length);
+
+    CHIP8_memory_written(chip8, MEMORY_PGM_START, length);
+}
+
+void CHIP8_load_program(CHIP8 *chip8, const CHIP8_program *program) {
+    CHIP8_load_rom_bytes(chip8, (uint8_t *) program->rom, program->length);
+    CHIP8_set_engine(chip8, CHIP8_ENGINE_AOT);
+
+    chip8->program = program;
+}
+
+void CHIP8_save_state(const CHIP8 *chip8, uint8_t *image) {
+    memcpy(image, STATE_MAGIC, 4);
+    image[4] = CHIP8_STATE_VERSION;
+    memset(image + 5, 0, 3);
+
+    memcpy(image + STATE_MEMORY, chip8->memory, sizeof(chip8->memory));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(image + STATE_VIDEO, chip8->video, sizeof(chip8->video));
+#else
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        put_le(image + STATE_VIDEO + 8 * y, chip8->video[y], 8);
+    }
+#endif
+
+    memcpy(image + STATE_REGISTERS, chip8->register_file.raw, 16);
+    put_le(image + STATE_I, chip8->I, 2);
+    put_le(image + STATE_PC, chip8->PC, 2);
+    image[STATE_SP] = chip8->SP;
+    for (int i = 0; i < 16; i++) {
+        put_le(image + STATE_STACK + 2 * i, chip8->stack[i], 2);
+    }
+
+    image[STATE_TIMERS] = chip8->delay_timer;
+    image[STATE_TIMERS + 1] = chip8->sound_timer;
+    put_le(image + STATE_CLOCK, chip8->clock_rate, 4);
+    put_le(image + STATE_CLOCK + 4, chip8->timer_phase, 4);
+
+    put_le(image + STATE_KEYS, chip8->keys, 2);
+    put_le(image + STATE_KEYS + 2, chip8->key_presses, 2);
+    image[STATE_KEYS + 4] = chip8->waiting_key;
+    image[STATE_KEYS + 5] = chip8->key_register;
+    put_le(image + STATE_RANDOM, chip8->random_state, 8);
+}
+
+int CHIP8_load_state(CHIP8 *chip8, const uint8_t *image, int length) {
+    if (length != CHIP8_STATE_SIZE || memcmp(image, STATE_MAGIC, 4) || image[4] != CHIP8_STATE_VERSION) {
+        return 0;
+    }
+
+    // the values used as indexes must be in range: PC addresses two bytes
+    uint32_t clock_rate = get_le(image + STATE_CLOCK, 4);
+    if (image[STATE_SP] > 16 || image[STATE_KEYS + 5] >= 16
+        || get_le(image + STATE_PC, 2) > 0xFFE || get_le(image + STATE_I, 2) > 0xFFF
+        || get_le(image + STATE_RANDOM, 8) == 0) {
+        return 0;
+    }
+
+    // a return address becomes PC
+    for (int i = 0; i < image[STATE_SP]; i++) {
+        if (get_le(image + STATE_STACK + 2 * i, 2) > 0xFFE) {
+            return 0;
+        }
+    }
+
+    // the scheduler keeps the phase below one timer period
+    if (clock_rate == 0 || get_le(image + STATE_CLOCK + 4, 4) >= clock_rate) {
+        return 0;
+    }
+
+    // engines caching decoded code only discard the chunks that changed
+    for (int address = 0; address < (int) sizeof(chip8->memory); address += STATE_CHUNK_SIZE) {
+        const uint8_t *chunk = image + STATE_MEMORY + address;
+
+        if (memcmp(chip8->memory + address, chunk, STATE_CHUNK_SIZE)) {
+            memcpy(chip8->memory + address, chunk, STATE_CHUNK_SIZE);
+            CHIP8_memory_written(chip8, address, STATE_CHUNK_SIZE);
+        }
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(chip8->video, image + STATE_VIDEO, sizeof(chip8->video));
+#else
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        chip8->video[y] = get_le(image + STATE_VIDEO + 8 * y, 8);
+    }
+#endif
+
+    memcpy(chip8->register_file.raw, image + STATE_REGISTERS, 16);
+    chip8->I = get_le(image + STATE_I, 2);
+    chip8->PC = get_le(image + STATE_PC, 2);
+    chip8->SP = image[STATE_SP];
+    for (int i = 0; i < 16; i++) {
+        chip8->stack[i] = get_le(image + STATE_STACK + 2 * i, 2);
+    }
+
+    chip8->delay_timer = image[STATE_TIMERS];
+    chip8->sound_timer = image[STATE_TIMERS + 1];
+    chip8->clock_rate = clock_rate;
+    chip8->timer_phase = get_le(image + STATE_CLOCK + 4, 4);
+
+    chip8->keys = get_le(image + STATE_KEYS, 2);
+    chip8->key_presses = get_le(image + STATE_KEYS + 2, 2);
+    chip8->waiting_key = image[STATE_KEYS + 4];
+    chip8->key_register = image[STATE_KEYS + 5];
+    chip8->random_state = get_le(image + STATE_RANDOM, 8);
+
+    // the frontend redraws the whole screen
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        chip8->damage[y] = ~(uint64_t) 0;
+        chip8->previous_frame[y] = chip8->video[y];
+    }
+
+    chip8->dirty_rows = ~(uint32_t) 0;
+
+    return 1;
+}
+
+uint64_t CHIP8_state_hash(const CHIP8 *chip8) {
+    uint8_t image[CHIP8_STATE_SIZE];
+    uint64_t hash = 0xCBF29CE484222325;
+
+    CHIP8_save_state(chip8, image);
+
+    for (int i = 0; i < CHIP8_STATE_SIZE; i++) {
+        hash = (hash ^ image[i]) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+void CHIP8_set_seed(CHIP8 *chip8, uint64_t seed) {
+    // splitmix64, so that close seeds give unrelated sequences
+    uint64_t state = seed + 0x9E3779B97F4A7C15;
+
+    state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9;
+    state = (state ^ (state >> 27)) * 0x94D049BB133111EB;
+    state ^= state >> 31;
+
+    chip8->random_state = state ? state : 1;
 }
 
-void CHIP8_set_refresh_function(CHIP8 *chip8, void (*refresh)(const uint8_t *)) {
+void CHIP8_set_refresh_function(CHIP8 *chip8, void (*refresh)(const uint64_t *)) {
     chip8->refresh_screen = refresh;
 }
 
+void CHIP8_set_refresh_damage_function(CHIP8 *chip8,
+                                       void (*refresh)(const uint64_t *, uint32_t, const uint64_t *)) {
+    chip8->refresh_damage = refresh;
+}
+
+void CHIP8_video_to_bytes(const uint64_t *video, uint8_t *pixels) {
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        for (int x = 0; x < VIDEO_WIDTH; x++) {
+            pixels[y * VIDEO_WIDTH + x] = (video[y] >> (63 - x)) & 1;
+        }
+    }
+}
+
 void CHIP8_set_beep_function(CHIP8 *chip8, void (*beep)()) {
     chip8->beep = beep;
 }
 
-void CHIP8_set_keyboard_input_function(CHIP8 *chip8, void (*keyboard_input)(uint8_t *keyboard)) {
+void CHIP8_set_keyboard_input_function(CHIP8 *chip8, void (*keyboard_input)(uint16_t *keys)) {
     chip8->keyboard_input = keyboard_input;
 }
 
+void CHIP8_set_wait_keyboard_input_function(CHIP8 *chip8, void (*wait_keyboard_input)(uint16_t *, int)) {
+    chip8->wait_keyboard_input = wait_keyboard_input;
+}
+
+void CHIP8_key_event(CHIP8 *chip8, uint8_t key, int pressed) {
+    uint16_t mask = 1 << (key & 0xF);
+
+    if (chip8->input_record != NULL && pressed && (chip8->keys & mask)) {
+        // a key pressed again: replayed as a release followed by a press
+        input_record_add(chip8->input_record, chip8->cycle_count, chip8->keys & ~mask);
+    }
+
+    if (pressed) {
+        chip8->keys |= mask;
+        chip8->key_presses |= mask;
+    } else {
+        chip8->keys &= ~mask;
+    }
+
+    if (chip8->input_record != NULL) {
+        input_record_add(chip8->input_record, chip8->cycle_count, chip8->keys);
+    }
+}
+
+void CHIP8_set_input_record(CHIP8 *chip8, struct input_record_s *record) {
+    chip8->input_record = record;
+}
+
+int CHIP8_set_profiling(CHIP8 *chip8, int enabled) {
+#ifdef CHIP8_PROFILE
+    if (enabled && chip8->profile == NULL) {
+        chip8->profile = profile_create();
+
+        if (!chip8->profile) {
+            fprintf(stderr, "Unable to allocate the profiler! Aborting...\n");
+            exit(1);
+        }
+    } else if (!enabled && chip8->profile != NULL) {
+        profile_destroy(chip8->profile);
+        chip8->profile = NULL;
+    }
+
+    return 1;
+#else
+    return !enabled;
+#endif
+}
+
+void CHIP8_set_trace(CHIP8 *chip8, struct trace_buffer_s *trace) {
+    chip8->trace = trace;
+}
+
+int CHIP8_set_clock_rate(CHIP8 *chip8, uint32_t clock_rate) {
+    // the scheduler divides by the clock rate
+    if (clock_rate == 0) {
+        return 0;
+    }
+
+    chip8->clock_rate = clock_rate;
+    chip8->timer_phase = 0;
+    chip8->run_start = -1;
+
+    return 1;
+}
+
+void CHIP8_set_turbo(CHIP8 *chip8, int turbo) {
+    chip8->turbo = turbo != 0;
+}
+
+void CHIP8_run(CHIP8 *chip8, uint32_t budget, CHIP8_run_status *status) {
+    int64_t now = CHIP8_time_ns();
+    uint32_t batch = chip8->clock_rate > TIMER_RATE ? chip8->clock_rate / TIMER_RATE : 1;
+    uint32_t executed = 0;
+
+    // in turbo mode the clock restarts at every run
+    if (chip8->run_start < 0 || chip8->turbo) {
+        chip8->run_start = now;
+        chip8->run_cycles = 0;
+    }
+
+    uint64_t due = chip8->turbo ? budget : ns_to_cycles(chip8, now - chip8->run_start);
+    // a key that arrived during the wait ends it at the next cycle
+    int blocked = chip8->waiting_key && chip8->keyboard_input == NULL && !(chip8->keys | chip8->key_presses);
+
+    if (blocked) {
+        // a blocked CPU only updates its timers, the last cycle checks the keys
+        uint64_t skipped = due > chip8->run_cycles ? due - chip8->run_cycles - 1 : 0;
+
+        // the cycles over the budget are left to the next run
+        skipped = skipped < budget ? skipped : budget;
+
+        advance_timers(chip8, skipped);
+        PROFILE(chip8, chip8->profile->wait_cycles += skipped);
+        chip8->run_cycles += skipped;
+        executed += skipped;
+
+        // a key press is handled without waiting for the next cycle
+        due = chip8->run_cycles + 1;
+    } else if (!chip8->turbo && due > chip8->run_cycles + ns_to_cycles(chip8, MAX_LAG)) {
+        // long delays are not recovered by running faster
+        chip8->run_start = now - cycles_to_ns(chip8, chip8->run_cycles);
+        due = chip8->run_cycles + batch;
+    }
+
+    while (chip8->run_cycles < due && executed < budget) {
+        int cycles = 1;
+
+        // the last cycles of the budget are ticked, so that a step does not exceed it
+        if (budget - executed > CHIP8_MAX_STEP_CYCLES) {
+            cycles = CHIP8_step(chip8);
+        } else {
+            CHIP8_tick(chip8);
+        }
+
+        chip8->run_cycles += cycles;
+        executed += cycles;
+
+        if (chip8->waiting_key && chip8->keyboard_input == NULL) {
+            break;
+        }
+    }
+
+    status->cycles = executed;
+    status->waiting_key = chip8->waiting_key;
+
+    if (chip8->waiting_key && chip8->keyboard_input == NULL) {
+        // show what was drawn before the wait
+        if (chip8->present_mode != CHIP8_PRESENT_IMMEDIATE) {
+            present_frame(chip8);
+        }
+
+        // stopped timers do not need updates
+        status->deadline = chip8->delay_timer || chip8->sound_timer
+                           ? chip8->run_start + cycles_to_ns(chip8, chip8->run_cycles + batch)
+                           : -1;
+    } else if (chip8->turbo || chip8->run_cycles < due) {
+        status->deadline = now;
+    } else {
+        status->deadline = chip8->run_start + cycles_to_ns(chip8, chip8->run_cycles + batch);
+    }
+}
+
+int64_t CHIP8_time_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#if CHIP8_TIMERFD
+void CHIP8_arm_timer(int timer, int64_t deadline) {
+    struct itimerspec spec = {0};
+
+    if (deadline >= 0) {
+        // a zero value would disarm the timer
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000 + (deadline == 0);
+    }
+
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+#endif
+
 _Noreturn void CHIP8_loop(CHIP8 *chip8) {
+    CHIP8_run_status status;
+
     while (1) {
-        CHIP8_tick(chip8);
+        CHIP8_run(chip8, UINT32_MAX, &status);
+
+        int64_t now = CHIP8_time_ns();
+        if (status.deadline >= 0 && status.deadline <= now) {
+            continue;
+        }
 
-        usleep(CLK_PERIOD);
+        if (status.waiting_key && chip8->wait_keyboard_input != NULL) {
+            chip8->wait_keyboard_input(&chip8->keys, status.deadline < 0 ? -1 : (int) ((status.deadline - now) / 1000));
+        } else if (status.deadline >= 0) {
+            struct timespec deadline = {status.deadline / 1000000000, status.deadline % 1000000000};
+
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        } else {
+            // no function can wait for the keyboard
+            usleep(1000000 / TIMER_RATE);
+        }
     }
 }
 
@@ -156,55 +622,358 @@ void CHIP8_tick(CHIP8 *chip8) {
     // reset the draw flag
     chip8->draw_flag = 0;
 
+    // a blocked CPU only checks the keyboard
+    if (chip8->waiting_key) {
+        PROFILE(chip8, chip8->profile->wait_cycles++);
+        resume_key_wait(chip8);
+        CHIP8_end_cycle(chip8);
+        return;
+    }
+
     // fetch instruction
     uint16_t opcode = (chip8->memory[chip8->PC] << 8) | (chip8->memory[chip8->PC + 1]);
 
     chip8->PC = chip8->PC + 2;
-    for (int i = 0; i < ISA_SIZE; i++) {
-        if ((opcode & chip8->ISA[i].mask) == chip8->ISA[i].opcode) {
-            chip8->ISA[i].execute(chip8, opcode);
+
+    // decode and execute
+    uint8_t index = decode_table[opcode];
+    PROFILE(chip8, profile_instruction(chip8->profile, chip8->PC - 2, index));
+    TRACE_BEGIN(chip8);
+
+    if (index != ISA_SIZE) {
+        instruction_set[index].execute(chip8, opcode);
+    }
+
+    TRACE_END(chip8, chip8->PC - 2, opcode);
+
+    CHIP8_end_cycle(chip8);
+}
+
+void CHIP8_set_engine(CHIP8 *chip8, CHIP8_engine engine) {
+    int use_cache = engine == CHIP8_ENGINE_BLOCK_CACHE
+                    || engine == CHIP8_ENGINE_SUPERINSTRUCTIONS
+                    || engine == CHIP8_ENGINE_JIT;
+    int fuse = engine == CHIP8_ENGINE_SUPERINSTRUCTIONS;
+
+    // blocks built for another engine cannot be reused
+    if (use_cache && chip8->block_cache != NULL && chip8->block_cache->fuse != fuse) {
+        CHIP8_set_engine(chip8, CHIP8_ENGINE_INTERPRETER);
+    }
+
+    if (use_cache && chip8->block_cache == NULL) {
+        chip8->block_cache = block_cache_create(fuse);
+
+        if (!chip8->block_cache) {
+            fprintf(stderr, "Unable to allocate the block cache! Aborting...\n");
+            exit(1);
+        }
+    } else if (!use_cache && chip8->block_cache != NULL) {
+        block_cache_destroy(chip8->block_cache);
+        chip8->block_cache = NULL;
+    }
+
+    // without a JIT the blocks are executed from the cache
+    if (engine == CHIP8_ENGINE_JIT && chip8->jit == NULL) {
+        chip8->jit = jit_create();
+    } else if (engine != CHIP8_ENGINE_JIT && chip8->jit != NULL) {
+        for (int i = 0; i < MEMORY_SIZE; i++) {
+            if (chip8->block_cache != NULL && chip8->block_cache->blocks[i] != NULL) {
+                chip8->block_cache->blocks[i]->native = NULL;
+            }
+        }
+
+        jit_destroy(chip8->jit);
+        chip8->jit = NULL;
+    }
+
+    chip8->engine = engine;
+}
+
+void CHIP8_set_present_mode(CHIP8 *chip8, CHIP8_present_mode mode) {
+    chip8->present_mode = mode;
+
+    memcpy(chip8->previous_frame, chip8->video, sizeof(chip8->video));
+    memcpy(chip8->shown_frame, chip8->video, sizeof(chip8->video));
+
+    // the frontend may be showing an older frame
+    memset(chip8->damage, 0xFF, sizeof(chip8->damage));
+    chip8->dirty_rows = 0xFFFFFFFF;
+}
+
+int CHIP8_step(CHIP8 *chip8) {
+    if (chip8->waiting_key) {
+        CHIP8_tick(chip8);
+        return 1;
+    }
+
+    int skipped = idle_loop_skip(chip8);
+
+    if (skipped) {
+        // the fast-forwarded iterations are charged to the start of the loop, where PC stays
+        PROFILE(chip8, chip8->profile->idle_cycles += skipped; chip8->profile->addresses[chip8->PC & 0xFFF] += skipped);
+        return skipped;
+    }
+
+    if (chip8->engine == CHIP8_ENGINE_AOT) {
+        // the translated code is not instrumented: a profiled or traced program is interpreted
+        int cycles = chip8->program != NULL && !INSTRUMENTED(chip8) ? chip8->program->run(chip8) : 0;
+
+        if (cycles) {
+            return cycles;
         }
+    } else if (chip8->engine != CHIP8_ENGINE_INTERPRETER) {
+        return CHIP8_run_block(chip8);
     }
 
-    if (chip8->draw_flag && chip8->refresh_screen != NULL) {
-        chip8->refresh_screen(chip8->video);
+    CHIP8_tick(chip8);
+    return 1;
+}
+
+int CHIP8_run_block(CHIP8 *chip8) {
+    block_t *block = block_cache_fetch(chip8->block_cache, chip8, chip8->PC);
+    const decoded_op_t *op = block->ops;
+
+    // the block must not be touched after its last instruction:
+    // a write to main memory may have invalidated it
+    int length = block->length;
+
+    if (block->native == NULL && chip8->jit != NULL && ++block->executions >= JIT_THRESHOLD) {
+        jit_compile(chip8->jit, chip8->block_cache, block);
     }
 
-    // update timers
-    if (chip8->delay_timer) {
-        chip8->delay_timer--;
+    // a profiled or traced block runs one instruction at a time
+    if (block->native != NULL && !INSTRUMENTED(chip8)) {
+        block->native(chip8);
+        return length;
     }
 
-    if (chip8->sound_timer) {
-        chip8->sound_timer--;
-        if (chip8->sound_timer == 1 && chip8->beep != NULL) {
-            chip8->beep();
+    int cycles = 0;
+    for (int i = 0; i < length;) {
+        if (block->fused[i] != NULL && !INSTRUMENTED(chip8)) {
+            int fused_length = block->fused_length[i];
+
+            cycles += block->fused[i](chip8, op);
+            i += fused_length;
+            op += fused_length;
+            continue;
+        }
+
+        chip8->draw_flag = 0;
+        PROFILE(chip8, profile_instruction(chip8->profile, chip8->PC, decode_table[op->opcode]));
+        TRACE_BEGIN(chip8);
+        chip8->PC = chip8->PC + 2;
+
+        if (op->execute != NULL) {
+            op->execute(chip8, op->opcode);
+        }
+
+        TRACE_END(chip8, chip8->PC - 2, op->opcode);
+
+        CHIP8_end_cycle(chip8);
+        cycles++;
+        i++;
+        op++;
+    }
+
+    return cycles;
+}
+
+instruction_runner CHIP8_decode(CHIP8 *chip8, uint16_t opcode) {
+    uint8_t index = decode_table[opcode];
+
+    return index != ISA_SIZE ? instruction_set[index].execute : NULL;
+}
+
+const instruction_t *CHIP8_decode_instruction(CHIP8 *chip8, uint16_t opcode) {
+    uint8_t index = decode_table[opcode];
+
+    return index != ISA_SIZE ? &instruction_set[index] : NULL;
+}
+
+void CHIP8_memory_written(CHIP8 *chip8, uint16_t address, uint16_t length) {
+    if (chip8->block_cache != NULL) {
+        block_cache_invalidate(chip8->block_cache, address, length);
+    }
+
+    // self-modifying code: the translation no longer matches the memory
+    if (chip8->program != NULL) {
+        for (uint32_t a = address; a < (uint32_t) address + length && a < MEMORY_SIZE; a++) {
+            if (chip8->program->code_map[a / 8] & (1 << (a % 8))) {
+                chip8->program = NULL;
+                break;
+            }
+        }
+    }
+}
+
+void CHIP8_end_cycle(CHIP8 *chip8) {
+    chip8->cycle_count++;
+
+    if (chip8->draw_flag && chip8->present_mode == CHIP8_PRESENT_IMMEDIATE) {
+        present_frame(chip8);
+    }
+
+    // update timers, more than once per cycle below TIMER_RATE instructions per second
+    chip8->timer_phase += TIMER_RATE;
+    while (chip8->timer_phase >= chip8->clock_rate) {
+        chip8->timer_phase -= chip8->clock_rate;
+        chip8->frame_count++;
+        PROFILE(chip8, profile_frames(chip8->profile, 1));
+        update_timers(chip8, 1);
+
+        // the frame ends with the timer period
+        if (chip8->present_mode != CHIP8_PRESENT_IMMEDIATE) {
+            present_frame(chip8);
         }
     }
 
     // keyboard management
     if (chip8->keyboard_input != NULL) {
-        chip8->keyboard_input(chip8->key);
+        uint16_t keys = chip8->keys;
+
+        chip8->keyboard_input(&chip8->keys);
+
+        if (chip8->input_record != NULL && chip8->keys != keys) {
+            input_record_add(chip8->input_record, chip8->cycle_count, chip8->keys);
+        }
+    }
+}
+
+void CHIP8_end_cycles(CHIP8 *chip8, uint64_t cycles) {
+    chip8->draw_flag = 0;
+
+    if (chip8->keyboard_input != NULL) {
+        for (uint64_t i = 0; i < cycles; i++) {
+            CHIP8_end_cycle(chip8);
+        }
+        return;
+    }
+
+    uint64_t frames = chip8->frame_count;
+
+    advance_timers(chip8, cycles);
+
+    // the screen does not change: the frames after the second one are empty
+    for (uint64_t i = frames; i < chip8->frame_count && i < frames + 2; i++) {
+        if (chip8->present_mode != CHIP8_PRESENT_IMMEDIATE) {
+            present_frame(chip8);
+        }
     }
 }
 
 
 /**
- * Helper function used to CHIP8_init instruction_s structs.
+ * Complete a key wait if a key is down or was pressed during the wait:
+ * the index of the key is stored in the register and the CPU starts
+ * running again.
+ *
+ * @param chip8 is a pointer to the emulator
+ */
+static void resume_key_wait(CHIP8 *chip8) {
+    uint16_t pressed = chip8->keys | chip8->key_presses;
+
+    if (pressed) {
+        chip8->register_file.raw[chip8->key_register] = __builtin_ctz(pressed);
+        chip8->key_presses = 0;
+        chip8->waiting_key = 0;
+        chip8->PC = chip8->PC + 2;
+    }
+}
+
+/**
+ * Update the timers as after the given number of cycles
+ * that did not draw nor read the keyboard.
  *
  * @param chip8 is a pointer to the emulator
- * @param index is the index of the instruction inside the
- *        CHIP8.ISA array
- * @param mask is a bitmask used to define which bits
- *        of an instruction are part of the opcode and which
- *        others are options or immediate values
- * @param opcode is the instruction's opcode
- * @param execute is the instruction's action
- */
-void define_instruction(CHIP8 *chip8, int index,
-                        uint16_t mask, uint16_t opcode,
-                        instruction_runner execute) {
-    chip8->ISA[index].mask = mask;
-    chip8->ISA[index].opcode = opcode;
-    chip8->ISA[index].execute = execute;
+ * @param cycles is the number of cycles
+ */
+static void advance_timers(CHIP8 *chip8, uint64_t cycles) {
+    uint64_t phase = chip8->timer_phase + cycles * TIMER_RATE;
+    uint64_t updates = phase / chip8->clock_rate;
+
+    chip8->timer_phase = phase % chip8->clock_rate;
+    chip8->cycle_count += cycles;
+    chip8->frame_count += updates;
+    PROFILE(chip8, profile_frames(chip8->profile, updates));
+    update_timers(chip8, updates < 256 ? (int) updates : 256);
 }
+
+/**
+ * Count the timers down by the given number of updates.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param updates is the number of timer updates
+ */
+static void update_timers(CHIP8 *chip8, int updates) {
+    chip8->delay_timer = chip8->delay_timer > updates ? chip8->delay_timer - updates : 0;
+
+    if (chip8->sound_timer) {
+        // the beep is emitted when the sound timer reaches 1
+        if (chip8->sound_timer > 1 && chip8->sound_timer - updates <= 1 && chip8->beep != NULL) {
+            chip8->beep();
+        }
+
+        chip8->sound_timer = chip8->sound_timer > updates ? chip8->sound_timer - updates : 0;
+    }
+}
+
+/**
+ * Send the frame to the frontend with the damage accumulated since
+ * the previous frame, then reset the damage. In the vblank modes
+ * nothing is sent if the frame did not change.
+ *
+ * @param chip8 is a pointer to the emulator
+ */
+static void present_frame(CHIP8 *chip8) {
+    const uint64_t *frame = chip8->video;
+
+    if (chip8->present_mode == CHIP8_PRESENT_VBLANK_MERGE) {
+        // the damage is the difference with the frame on screen
+        chip8->dirty_rows = 0;
+
+        for (int y = 0; y < VIDEO_HEIGHT; y++) {
+            uint64_t merged = chip8->video[y] | chip8->previous_frame[y];
+
+            chip8->damage[y] = merged ^ chip8->shown_frame[y];
+            chip8->dirty_rows |= (uint32_t) (chip8->damage[y] != 0) << y;
+            chip8->shown_frame[y] = merged;
+            chip8->previous_frame[y] = chip8->video[y];
+        }
+
+        frame = chip8->shown_frame;
+    }
+
+    if (chip8->present_mode != CHIP8_PRESENT_IMMEDIATE && !chip8->dirty_rows) {
+        return;
+    }
+
+    if (chip8->refresh_damage != NULL) {
+        chip8->refresh_damage(frame, chip8->dirty_rows, chip8->damage);
+    } else if (chip8->refresh_screen != NULL) {
+        chip8->refresh_screen(frame);
+    }
+
+    memset(chip8->damage, 0, sizeof(chip8->damage));
+    chip8->dirty_rows = 0;
+}
+
+
+/**
+ * Return the number of cycles completed in the given time
+ */
+static uint64_t ns_to_cycles(CHIP8 *chip8, int64_t ns) {
+    if (ns <= 0) {
+        return 0;
+    }
+
+    // split the seconds to avoid overflows
+    return (ns / 1000000000) * chip8->clock_rate + (ns % 1000000000) * chip8->clock_rate / 1000000000;
+}
+
+/**
+ * Return the time needed to complete the given number of cycles
+ */
+static int64_t cycles_to_ns(CHIP8 *chip8, uint64_t cycles) {
+    return (int64_t) (cycles / chip8->clock_rate) * 1000000000
+           + (int64_t) (cycles % chip8->clock_rate) * 1000000000 / chip8->clock_rate;
+}
\ No newline at end of file
@@ -7,26 +7,139 @@
 #define MEMORY_PGM_START 0x200
 #define FONTSET_SIZE 80
 #define VIDEO_SIZE 64 * 32
+#define VIDEO_WIDTH 64
+#define VIDEO_HEIGHT 32
 #define NUM_KEYS 16
 
+#define TIMER_RATE 60
+#define DEFAULT_CLOCK_RATE 500
+
+/**
+ * The deadlines of CHIP8_run can be waited on with a timerfd
+ * (see CHIP8_arm_timer) on Linux hosts.
+ */
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#define CHIP8_TIMERFD 1
+#else
+#define CHIP8_TIMERFD 0
+#endif
+
 #define ISA_SIZE 35
 
+/**
+ * Save states: version of the image format and size of an image
+ * (header, memory, video, registers, I, PC, stack, timers, scheduler
+ * phase, keyboard, key wait and random number generator)
+ */
+#define CHIP8_STATE_VERSION 2
+#define CHIP8_STATE_SIZE (8 + 4096 + 8 * VIDEO_HEIGHT + 16 + 2 + 2 + 1 + 2 * 16 + 2 + 8 + 6 + 8)
+
+/**
+ * Maximum number of cycles emulated by a single CHIP8_step
+ * (an idle loop skip of three-instruction iterations)
+ */
+#define CHIP8_MAX_STEP_CYCLES 768
+
 struct CHIP8_s;
 typedef struct CHIP8_s CHIP8;
 
+struct block_cache_s;
+struct jit_s;
+struct input_record_s;
+struct profile_s;
+struct trace_buffer_s;
+
 typedef void (*instruction_runner)(CHIP8 *, uint16_t);
 
+/**
+ * Execution engines available to the emulator.
+ *
+ *  - CHIP8_ENGINE_INTERPRETER fetches and decodes one opcode per cycle
+ *  - CHIP8_ENGINE_BLOCK_CACHE decodes the program once into basic blocks
+ *    of predecoded instructions and executes them from the cache
+ *  - CHIP8_ENGINE_SUPERINSTRUCTIONS runs the block cache, replacing
+ *    frequent instruction sequences with superinstructions
+ *  - CHIP8_ENGINE_JIT runs the block cache and translates hot blocks
+ *    to native x86-64 code. On other hosts it behaves as the block cache.
+ *  - CHIP8_ENGINE_AOT runs a ROM translated to C ahead of time
+ *    (see CHIP8_load_program), and the interpreter elsewhere.
+ */
+typedef enum {
+    CHIP8_ENGINE_INTERPRETER,
+    CHIP8_ENGINE_BLOCK_CACHE,
+    CHIP8_ENGINE_SUPERINSTRUCTIONS,
+    CHIP8_ENGINE_JIT,
+    CHIP8_ENGINE_AOT
+} CHIP8_engine;
+
+/**
+ * When the frontend is asked to update the screen.
+ *
+ *  - CHIP8_PRESENT_IMMEDIATE refreshes the screen after every draw
+ *  - CHIP8_PRESENT_VBLANK collects the changes made during a 60 Hz frame
+ *    and refreshes the screen once at the end of the frame
+ *  - CHIP8_PRESENT_VBLANK_MERGE is like CHIP8_PRESENT_VBLANK, but shows
+ *    every pixel lit in either of the last two frames, hiding the
+ *    flicker of sprites that are erased and drawn again
+ */
+typedef enum {
+    CHIP8_PRESENT_IMMEDIATE,
+    CHIP8_PRESENT_VBLANK,
+    CHIP8_PRESENT_VBLANK_MERGE
+} CHIP8_present_mode;
+
+/**
+ * A ROM translated to C by the ahead-of-time translator.
+ *
+ * The translation is only valid while the translated code is not
+ * modified: as soon as the program writes to an address marked in
+ * code_map, the emulator discards it and keeps interpreting.
+ */
+struct CHIP8_program_s {
+    // content of the translated rom
+    const uint8_t *rom;
+    int length;
+
+    // one bit per memory address, set for translated instructions
+    const uint8_t *code_map;
+
+    /**
+     * Run the translated block that starts at PC.
+     * @return the number of emulated cycles,
+     *         or 0 if no block starts at PC
+     */
+    int (*run)(CHIP8 *chip8);
+};
+
+typedef struct CHIP8_program_s CHIP8_program;
+
+/**
+ * Outcome of CHIP8_run.
+ */
+struct CHIP8_run_status_s {
+    // number of emulated cycles
+    uint32_t cycles;
+
+    // CLOCK_MONOTONIC time in nanoseconds at which CHIP8_run must be
+    // called again, or -1 if the emulator only resumes on a key press
+    int64_t deadline;
+
+    // nonzero if the CPU is blocked on Fx0A waiting for a key
+    uint8_t waiting_key;
+};
+
+typedef struct CHIP8_run_status_s CHIP8_run_status;
+
 /**
  * Instructions available on the CHIP8 architecture
- * are represented by means of an instruction_s struct
- * and stored in the ISA field of the CHIP8_s struct.
+ * are represented by means of an instruction_s struct,
+ * in a table shared by all the emulators (the ISA field).
  *
- * When a new opcode is fetched from memory, the
- * emulator scans the ISA array looking for a matching
- * instructions. More in details, an opcode O and an instruction I
- * match if the result of the bitwise AND between O and I.mask is
- * equal to I.opcode. When a match is found, the corresponding
- * action is executed.
+ * An opcode O and an instruction I match if the result of the
+ * bitwise AND between O and I.mask is equal to I.opcode.
+ * When the ISA is loaded, the emulator precomputes the matching
+ * instruction of every possible opcode, so that a fetched opcode
+ * is decoded with a single table lookup.
  */
 struct instruction_s {
     uint16_t mask;
@@ -34,27 +147,33 @@ struct instruction_s {
 
     // pointer to the function that executes the instruction
     instruction_runner execute;
+
+    // name of the function that executes the instruction
+    const char *name;
 };
 
 typedef struct instruction_s instruction_t;
 
-struct CHIP8_s {
-    /**
-     * CHIP-8 can address 4 KB of memory.
-     *
-     * Memory map:
-     *  - [0x000, 0x1FF]: reserved for the CHIP-8 interpreter
-     *  - 0x200: start of most CHIP-8 programs
-     *  - 0x600: start of ETI 660 CHIP-8 programs
-     *  - [0x200, 0xFFF]: CHIP-8 program/data space
-     */
-    uint8_t memory[4096];
+/**
+ * Alignment of the emulator: the hot CPU state fills the first cache
+ * line, the dispatch state the second one.
+ */
+#define CHIP8_CACHE_LINE 64
 
+/**
+ * State of an emulator, laid out by temperature: the CPU state used by
+ * every instruction comes first and fills one cache line, followed by
+ * the pointers read at every step, the stack and the scheduler clock,
+ * then the screen and memory buffers. Callbacks and other fields only
+ * used by the frontends come last. The instruction set is shared by all
+ * the emulators and is not part of this struct.
+ */
+struct CHIP8_s {
     /**
      * 16 general purpose 8-bit register
      * registers are referred as Vx (x is an hex digit between 0 and F)
      */
-    union register_file {
+    _Alignas(CHIP8_CACHE_LINE) union register_file {
         uint8_t raw[16];
         struct {
             uint8_t V0;
@@ -87,12 +206,9 @@ struct CHIP8_s {
     uint16_t PC;
 
     /**
-     * Video memory
-     * CHIP8 has a 64x32 monochromatic screen. A lit pixel
-     * is represented as a nonzero value in the video matrix.
-     * Pixels are stored rows first.
+     * Stack pointer (see stack)
      */
-    uint8_t video[64 * 32];
+    uint8_t SP;
 
     /**
      * Timers
@@ -102,33 +218,166 @@ struct CHIP8_s {
     uint8_t sound_timer;
 
     /**
-     * Stack: 16 16-bit values
+     * Key wait: when this flag is set to a nonzero value the CPU is
+     * blocked on Fx0A and no instruction is executed until a key is
+     * pressed. The index of the key is then stored in V[key_register].
      */
-    uint16_t stack[16];
-    uint8_t SP;
+    uint8_t waiting_key;
+    uint8_t key_register;
+
+    /**
+     * Draw flag: when this flag is set to a nonzero value
+     * the screen needs to be refreshed.
+     */
+    uint8_t draw_flag;
 
     /**
      * Keyboard
-     * CHIP8 has a 16 keys keyboard
+     * CHIP8 has a 16 keys keyboard: bit i of keys is set while key i
+     * is down. Bit i of key_presses is set when key i goes down, and
+     * the CPU clears it when it starts waiting for a key, so that
+     * short presses are not missed while it waits.
      */
-    uint8_t key[16];
+    uint16_t keys;
+    uint16_t key_presses;
 
     /**
-     * Draw flag: when this flag is set to a nonzero value
-     * the screen needs to be refreshed.
+     * Scheduler
+     * The CPU executes clock_rate instructions per second and the
+     * timers are updated TIMER_RATE times per second. timer_phase
+     * counts the cycles since the last timer update, in units of
+     * 1 / (clock_rate * TIMER_RATE) seconds. cycle_count and frame_count
+     * count the cycles and the timer updates (frames) since the
+     * initialization of the emulator.
      */
-    uint8_t draw_flag;
+    uint32_t timer_phase;
+    uint32_t clock_rate;
+    uint64_t cycle_count;
+    uint64_t frame_count;
 
     /**
-     * Instruction set
+     * State of the xorshift64 generator used by Cxkk,
+     * never zero (see CHIP8_set_seed)
      */
-    instruction_t ISA[ISA_SIZE];
+    uint64_t random_state;
+
+    /**
+     * Engine used by CHIP8_step and CHIP8_loop
+     */
+    _Alignas(CHIP8_CACHE_LINE) CHIP8_engine engine;
+
+    /**
+     * Frame presentation: frames end when the timers are updated
+     * (see previous_frame and shown_frame).
+     */
+    CHIP8_present_mode present_mode;
+
+    /**
+     * Predecoded blocks used by the block cache engine,
+     * NULL when the engine is not in use.
+     */
+    struct block_cache_s *block_cache;
+
+    /**
+     * Native code generator used by the JIT engine,
+     * NULL when the engine is not in use or not supported.
+     */
+    struct jit_s *jit;
+
+    /**
+     * Translated program run by the AOT engine,
+     * NULL if no valid translation is available.
+     */
+    const CHIP8_program *program;
+
+    /**
+     * Function called by the emulator in order to read the keyboard status.
+     * @param keys is a pointer to the bitmask of the keys that are down
+     */
+    void (*keyboard_input)(uint16_t *keys);
+
+    /**
+     * Recording of the keyboard, NULL if the keyboard is not recorded
+     */
+    struct input_record_s *input_record;
+
+    /**
+     * Counters of the profiler (see profiler.h), NULL if not profiling
+     */
+    struct profile_s *profile;
+
+    /**
+     * Ring buffer of the tracer (see trace_buffer.h), NULL if not tracing
+     */
+    struct trace_buffer_s *trace;
+
+    /**
+     * Stack: 16 16-bit values
+     */
+    _Alignas(CHIP8_CACHE_LINE) uint16_t stack[16];
+
+    /**
+     * Clock of CHIP8_run: CLOCK_MONOTONIC time in nanoseconds of
+     * cycle 0 (-1 if not started) and cycles emulated since then.
+     * In turbo mode CHIP8_loop runs the CPU as fast as possible.
+     */
+    int64_t run_start;
+    uint64_t run_cycles;
+    uint8_t turbo;
+
+    /**
+     * Damage since the last refresh: damage[y] has a bit set for
+     * every pixel of row y that may have changed, and bit y of
+     * dirty_rows is set when damage[y] is nonzero.
+     */
+    uint32_t dirty_rows;
+    uint64_t damage[VIDEO_HEIGHT];
+
+    /**
+     * Video memory
+     * CHIP8 has a 64x32 monochromatic screen. Each row is stored
+     * in a 64 bit word, the leftmost pixel in the most significant bit.
+     * A lit pixel is represented as a set bit.
+     */
+    uint64_t video[VIDEO_HEIGHT];
+
+    /**
+     * CHIP-8 can address 4 KB of memory.
+     *
+     * Memory map:
+     *  - [0x000, 0x1FF]: reserved for the CHIP-8 interpreter
+     *  - 0x200: start of most CHIP-8 programs
+     *  - 0x600: start of ETI 660 CHIP-8 programs
+     *  - [0x200, 0xFFF]: CHIP-8 program/data space
+     */
+    _Alignas(CHIP8_CACHE_LINE) uint8_t memory[4096];
+
+    /**
+     * Frame presentation: content of the video memory at the end
+     * of the previous frame and last frame shown by the frontend.
+     */
+    uint64_t previous_frame[VIDEO_HEIGHT];
+    uint64_t shown_frame[VIDEO_HEIGHT];
+
+    /**
+     * Instruction set, shared by all the emulators (read-only)
+     */
+    const instruction_t *ISA;
 
     /**
      * Function called by the emulator in order to update the screen.
-     * @param video is a pointer to the matrix that stores the screen content
+     * @param video is a pointer to the rows that store the screen content
+     */
+    void (*refresh_screen)(const uint64_t *video);
+
+    /**
+     * Function called by the emulator in order to update the changed part of the screen,
+     * used instead of refresh_screen when set.
+     * @param video is a pointer to the rows that store the screen content
+     * @param dirty_rows has bit y set if row y changed
+     * @param damage is a pointer to the masks of the pixels that changed in each row
      */
-    void (*refresh_screen)(const uint8_t *video);
+    void (*refresh_damage)(const uint64_t *video, uint32_t dirty_rows, const uint64_t *damage);
 
     /**
      * Function called by the emulator in order to emit a BEEP.
@@ -136,13 +385,18 @@ struct CHIP8_s {
     void (*beep)();
 
     /**
-     * Function called by the emulator in order to read the keyboard status.
+     * Function called by CHIP8_loop while the CPU waits for a key.
+     * It blocks until the keyboard status changes or the timeout expires.
+     * @param keys is a pointer to the bitmask of the keys that are down
+     * @param timeout is the maximum waiting time in microseconds, negative to wait forever
      */
-    void (*keyboard_input)(uint8_t *keyboard);
+    void (*wait_keyboard_input)(uint16_t *keys, int timeout);
 };
 
 /**
- * Initialize the CHIP8 emulator and load the provided rom in main memory.
+ * Initialize the CHIP8 emulator: the whole machine is reset, so the
+ * struct does not need to be zeroed first. The resources of a previous
+ * engine are not released.
  *
  * @param chip8 is a pointer to the CHIP8 struct
  */
@@ -165,13 +419,88 @@ extern void CHIP8_load_rom_from_file(CHIP8 *chip8, char *path);
  */
 extern void CHIP8_load_rom_bytes(CHIP8 *chip8, uint8_t *rom, int length);
 
+/**
+ * Load a ROM translated ahead of time in the CHIP8 memory
+ * and select the AOT engine to run it.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param program is the translated program
+ */
+extern void CHIP8_load_program(CHIP8 *chip8, const CHIP8_program *program);
+
+/**
+ * Save the state of the machine in a CHIP8_STATE_SIZE bytes image.
+ *
+ * The image only holds the machine (memory, registers, I, PC, stack,
+ * timers, keyboard and video), with a fixed little-endian layout:
+ * it does not depend on the host, on the engine or on the frontend.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param image is the buffer receiving the image
+ */
+extern void CHIP8_save_state(const CHIP8 *chip8, uint8_t *image);
+
+/**
+ * Restore the machine from an image written by CHIP8_save_state.
+ *
+ * The instruction set, the engine and the callbacks are kept. Only the
+ * memory that differs from the image is written, so the engines keep
+ * the code they decoded for the unchanged memory. The whole screen is
+ * reported as damaged.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param image is the image
+ * @param length is the size of the image
+ * @return 1 on success, 0 if the image is not valid (the machine is unchanged)
+ */
+extern int CHIP8_load_state(CHIP8 *chip8, const uint8_t *image, int length);
+
+/**
+ * Hash the state of the machine: two machines with the same hash
+ * are in the same state (FNV-1a of the save state image).
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @return the hash
+ */
+extern uint64_t CHIP8_state_hash(const CHIP8 *chip8);
+
+/**
+ * Seed the random number generator used by Cxkk. Two machines with
+ * the same seed, program and inputs execute the same instructions.
+ * CHIP8_init seeds the generator with the process id.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param seed is the seed
+ */
+extern void CHIP8_set_seed(CHIP8 *chip8, uint64_t seed);
+
 /**
  * Set the function called by the emulator in order to update the screen.
  *
  * @param chip8 is a pointer to the CHIP8 struct
  * @param refresh is a pointer to the function
  */
-extern void CHIP8_set_refresh_function(CHIP8 *chip8, void (*refresh)(const uint8_t *));
+extern void CHIP8_set_refresh_function(CHIP8 *chip8, void (*refresh)(const uint64_t *));
+
+/**
+ * Set the function called by the emulator in order to update the
+ * part of the screen that changed since the previous update.
+ * When set, it is called instead of the refresh function.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param refresh is a pointer to the function
+ */
+extern void CHIP8_set_refresh_damage_function(CHIP8 *chip8,
+                                              void (*refresh)(const uint64_t *, uint32_t, const uint64_t *));
+
+/**
+ * Convert the video memory to one byte per pixel, rows first,
+ * for the frontends that draw the screen pixel by pixel.
+ *
+ * @param video is a pointer to the video memory of the emulator
+ * @param pixels is the destination: VIDEO_SIZE bytes set to 1 for the lit pixels and to 0 otherwise
+ */
+extern void CHIP8_video_to_bytes(const uint64_t *video, uint8_t *pixels);
 
 /**
  * Set the function called by the emulator in order to emit a beep.
@@ -187,10 +516,121 @@ extern void CHIP8_set_beep_function(CHIP8 *chip8, void (*beep)());
  * @param chip8 is a pointer to the CHIP8 emulator
  * @param keyboard_input is a pointer to the function
  */
-extern void CHIP8_set_keyboard_input_function(CHIP8 *chip8, void (*keyboard_input)(uint8_t *));
+extern void CHIP8_set_keyboard_input_function(CHIP8 *chip8, void (*keyboard_input)(uint16_t *));
+
+/**
+ * Set the function called by CHIP8_loop in order to wait for a key
+ * while the CPU is blocked on Fx0A. Without this function the keyboard
+ * is polled once per cycle as when the CPU is running.
+ *
+ * @param chip8 is a pointer to the CHIP8 emulator
+ * @param wait_keyboard_input is a pointer to the function
+ */
+extern void CHIP8_set_wait_keyboard_input_function(CHIP8 *chip8, void (*wait_keyboard_input)(uint16_t *, int));
+
+/**
+ * Press or release a key. Frontends that receive key events call this
+ * function instead of setting a keyboard_input function.
+ *
+ * @param chip8 is a pointer to the CHIP8 emulator
+ * @param key is the key (0x0 to 0xF)
+ * @param pressed is nonzero if the key goes down, zero if it goes up
+ */
+extern void CHIP8_key_event(CHIP8 *chip8, uint8_t key, int pressed);
+
+/**
+ * Record the changes of the keyboard, both from CHIP8_key_event and
+ * from the keyboard input function, with the cycle at which they happen.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param record is the recording (see input_record.h), NULL to stop recording
+ */
+extern void CHIP8_set_input_record(CHIP8 *chip8, struct input_record_s *record);
+
+/**
+ * Start or stop counting the instructions executed, the cycles spent
+ * at each address and the instructions executed in each frame (see
+ * profiler.h). Stopping discards the counters.
+ *
+ * The profiler is only available if the core is compiled with
+ * -DCHIP8_PROFILE; otherwise the counting code is left out entirely.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param enabled is nonzero to start profiling, zero to stop
+ * @return 1 on success, 0 if profiling is requested but not compiled in
+ */
+extern int CHIP8_set_profiling(CHIP8 *chip8, int enabled);
+
+/**
+ * Record the last instructions executed in a ring buffer (see
+ * trace_buffer.h). The buffer is owned by the caller.
+ *
+ * @param chip8 is a pointer to the CHIP8 struct
+ * @param trace is the buffer, NULL to stop tracing
+ */
+extern void CHIP8_set_trace(CHIP8 *chip8, struct trace_buffer_s *trace);
+
+/**
+ * Set the number of instructions executed per second.
+ * The timers keep running at TIMER_RATE.
+ *
+ * @param chip8 is a pointer to the CHIP8 emulator
+ * @param clock_rate is the number of instructions per second
+ * @return 1 on success, 0 if clock_rate is zero (the clock rate is not changed)
+ */
+extern int CHIP8_set_clock_rate(CHIP8 *chip8, uint32_t clock_rate);
+
+/**
+ * Enable or disable the turbo mode: CHIP8_loop does not wait
+ * between the instructions and runs the CPU as fast as possible.
+ * The timers still run at TIMER_RATE in emulated time.
+ *
+ * @param chip8 is a pointer to the CHIP8 emulator
+ * @param turbo is nonzero to enable the turbo mode
+ */
+extern void CHIP8_set_turbo(CHIP8 *chip8, int turbo);
+
+/**
+ * Run the emulator until it catches up with the clock, then return.
+ *
+ * The cycles due since the previous call are executed, at most
+ * budget of them. The status reports when the next batch of cycles
+ * (one timer period) is due, so that the caller can sleep, poll or
+ * run other emulators until then. In turbo mode the next batch
+ * is always due immediately.
+ *
+ * While the CPU is blocked on Fx0A and no keyboard_input function is
+ * set, no instruction is executed: the caller calls CHIP8_key_event and
+ * CHIP8_run again when a key is pressed, and the time spent
+ * blocked only updates the timers.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param budget is the maximum number of cycles to execute
+ * @param status is filled with the outcome of the run
+ */
+extern void CHIP8_run(CHIP8 *chip8, uint32_t budget, CHIP8_run_status *status);
+
+/**
+ * Read the clock of the CHIP8_run deadlines.
+ *
+ * @return the CLOCK_MONOTONIC time in nanoseconds
+ */
+extern int64_t CHIP8_time_ns();
+
+#if CHIP8_TIMERFD
+/**
+ * Arm a timerfd at a deadline reported by CHIP8_run.
+ *
+ * @param timer is a CLOCK_MONOTONIC timerfd
+ * @param deadline is the CLOCK_MONOTONIC deadline in nanoseconds, -1 to disarm the timer
+ */
+extern void CHIP8_arm_timer(int timer, int64_t deadline);
+#endif
 
 /**
  * Main CPU loop: fetch, decode, execute and repeat.
+ * Runs CHIP8_run and sleeps until the next deadline, or waits
+ * with the wait_keyboard_input function while the CPU is blocked.
  * @param chip8 is a pointer to the emulator
  */
 _Noreturn extern void CHIP8_loop(CHIP8 *chip8);
@@ -201,4 +641,91 @@ _Noreturn extern void CHIP8_loop(CHIP8 *chip8);
  */
 extern void CHIP8_tick(CHIP8 *chip8);
 
+/**
+ * Select the engine used to execute the program.
+ * Switching engine releases the caches the new engine does not use.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param engine is the engine to use
+ */
+extern void CHIP8_set_engine(CHIP8 *chip8, CHIP8_engine engine);
+
+/**
+ * Select when the frontend is asked to update the screen.
+ * The next update redraws the whole screen.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param mode is the presentation mode
+ */
+extern void CHIP8_set_present_mode(CHIP8 *chip8, CHIP8_present_mode mode);
+
+/**
+ * Execute the next unit of work of the selected engine:
+ * a single cycle for the interpreter, a basic block for the other engines.
+ * When PC is at a loop that only waits for the delay timer or for a key,
+ * the iterations of the loop are fast-forwarded instead (see idle_loop.h).
+ *
+ * @param chip8 is a pointer to the emulator
+ * @return the number of emulated cycles
+ */
+extern int CHIP8_step(CHIP8 *chip8);
+
+/**
+ * Execute the basic block starting at PC from the block cache,
+ * decoding it first if it is not cached yet. With the JIT engine,
+ * hot blocks are translated to native code and run natively.
+ * The block cache or the JIT engine must be selected.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @return the number of emulated cycles
+ */
+extern int CHIP8_run_block(CHIP8 *chip8);
+
+/**
+ * Return the function that executes the given opcode,
+ * or NULL if the opcode is not part of the instruction set.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param opcode is the opcode to decode
+ */
+extern instruction_runner CHIP8_decode(CHIP8 *chip8, uint16_t opcode);
+
+/**
+ * Return the ISA entry that executes the given opcode,
+ * or NULL if the opcode is not part of the instruction set.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param opcode is the opcode to decode
+ */
+extern const instruction_t *CHIP8_decode_instruction(CHIP8 *chip8, uint16_t opcode);
+
+/**
+ * Complete the current cycle: refresh the screen if needed,
+ * update the timers and read the keyboard.
+ * Engines call this function after each executed instruction.
+ *
+ * @param chip8 is a pointer to the emulator
+ */
+extern void CHIP8_end_cycle(CHIP8 *chip8);
+
+/**
+ * Complete the given number of cycles that did not draw nor write to
+ * memory, as CHIP8_end_cycle would. Without a keyboard_input function
+ * nothing is polled, so the timers are advanced in one go.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param cycles is the number of cycles
+ */
+extern void CHIP8_end_cycles(CHIP8 *chip8, uint64_t cycles);
+
+/**
+ * Notify the emulator that the program wrote to main memory,
+ * so that engines caching decoded code can discard stale entries.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param address is the first written address
+ * @param length is the number of written bytes
+ */
+extern void CHIP8_memory_written(CHIP8 *chip8, uint16_t address, uint16_t length);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,606 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "assembler.h"
+
+#define MAX_OPERANDS 3
+
+// maximum number of values of a db or dw directive
+#define MAX_VALUES 64
+
+/**
+ * Kinds of operand accepted by an instruction form
+ *  - REGISTER_X, REGISTER_Y: Vx in bits 8-11, Vy in bits 4-7
+ *  - REGISTER_0: V0 only
+ *  - ADDRESS, BYTE, NIBBLE: a value in bits 0-11, 0-7, 0-3
+ *  - the other kinds are keywords that must appear as written
+ */
+enum operand_kind_e {
+    REGISTER_X,
+    REGISTER_Y,
+    REGISTER_0,
+    ADDRESS,
+    BYTE,
+    NIBBLE,
+    KEYWORD_I,
+    KEYWORD_INDIRECT,
+    KEYWORD_DT,
+    KEYWORD_ST,
+    KEYWORD_K,
+    KEYWORD_F,
+    KEYWORD_B,
+    NONE
+};
+
+typedef enum operand_kind_e operand_kind;
+
+/**
+ * An instruction form: a mnemonic with a given list of operands.
+ * The disassembler uses the first form matching an opcode.
+ */
+struct form_s {
+    const char *mnemonic;
+    uint16_t opcode;
+    operand_kind operands[MAX_OPERANDS];
+};
+
+typedef struct form_s form_t;
+
+static const form_t forms[] = {
+        {"CLS",  0x00E0, {NONE}},
+        {"RET",  0x00EE, {NONE}},
+        {"SYS",  0x0000, {ADDRESS,          NONE}},
+        {"JP",   0x1000, {ADDRESS,          NONE}},
+        {"JP",   0xB000, {REGISTER_0,       ADDRESS,    NONE}},
+        {"CALL", 0x2000, {ADDRESS,          NONE}},
+        {"SE",   0x3000, {REGISTER_X,       BYTE,       NONE}},
+        {"SE",   0x5000, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"SNE",  0x4000, {REGISTER_X,       BYTE,       NONE}},
+        {"SNE",  0x9000, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"LD",   0x6000, {REGISTER_X,       BYTE,       NONE}},
+        {"LD",   0x8000, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"LD",   0xA000, {KEYWORD_I,        ADDRESS,    NONE}},
+        {"LD",   0xF007, {REGISTER_X,       KEYWORD_DT, NONE}},
+        {"LD",   0xF00A, {REGISTER_X,       KEYWORD_K,  NONE}},
+        {"LD",   0xF015, {KEYWORD_DT,       REGISTER_X, NONE}},
+        {"LD",   0xF018, {KEYWORD_ST,       REGISTER_X, NONE}},
+        {"LD",   0xF029, {KEYWORD_F,        REGISTER_X, NONE}},
+        {"LD",   0xF033, {KEYWORD_B,        REGISTER_X, NONE}},
+        {"LD",   0xF055, {KEYWORD_INDIRECT, REGISTER_X, NONE}},
+        {"LD",   0xF065, {REGISTER_X,       KEYWORD_INDIRECT, NONE}},
+        {"ADD",  0x7000, {REGISTER_X,       BYTE,       NONE}},
+        {"ADD",  0x8004, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"ADD",  0xF01E, {KEYWORD_I,        REGISTER_X, NONE}},
+        {"OR",   0x8001, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"AND",  0x8002, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"XOR",  0x8003, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"SUB",  0x8005, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"SHR",  0x8006, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"SHR",  0x8006, {REGISTER_X,       NONE}},
+        {"SUBN", 0x8007, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"SHL",  0x800E, {REGISTER_X,       REGISTER_Y, NONE}},
+        {"SHL",  0x800E, {REGISTER_X,       NONE}},
+        {"RND",  0xC000, {REGISTER_X,       BYTE,       NONE}},
+        {"DRW",  0xD000, {REGISTER_X,       REGISTER_Y, NIBBLE}},
+        {"SKP",  0xE09E, {REGISTER_X,       NONE}},
+        {"SKNP", 0xE0A1, {REGISTER_X,       NONE}},
+};
+
+#define NUM_FORMS (sizeof(forms) / sizeof(forms[0]))
+
+static const char *keywords[] = {
+        [KEYWORD_I] = "I",
+        [KEYWORD_INDIRECT] = "[I]",
+        [KEYWORD_DT] = "DT",
+        [KEYWORD_ST] = "ST",
+        [KEYWORD_K] = "K",
+        [KEYWORD_F] = "F",
+        [KEYWORD_B] = "B",
+};
+
+struct label_s {
+    char name[ASSEMBLER_MAX_LABEL_LENGTH];
+    uint16_t address;
+};
+
+typedef struct label_s label_t;
+
+/**
+ * State of the assembler while it goes through the source
+ */
+struct assembler_s {
+    label_t labels[ASSEMBLER_MAX_LABELS];
+    int count;
+
+    // 1 while the labels are collected, 2 while the bytes are emitted
+    int pass;
+    int line;
+    int errors;
+
+    uint8_t *program;
+    int capacity;
+    int size;
+};
+
+typedef struct assembler_s assembler_t;
+
+static void assemble_line(assembler_t *as, char *text);
+
+static void assemble_instruction(assembler_t *as, const char *mnemonic, char **operands, int count);
+
+static void assemble_data(assembler_t *as, int width, char **operands, int count);
+
+static int evaluate(assembler_t *as, const char *text, int *value);
+
+static int register_index(const char *text);
+
+static int is_keyword(const char *name, size_t length);
+
+static const label_t *find_label(const assembler_t *as, const char *name, size_t length);
+
+static void emit(assembler_t *as, uint8_t byte);
+
+static void error(assembler_t *as, const char *format, const char *argument);
+
+static char *trim(char *text);
+
+
+int assemble_program(const char *source, uint8_t *program, int capacity) {
+    // not static: several programs can be assembled at the same time
+    assembler_t as;
+
+    memset(&as, 0, sizeof(as));
+    as.program = program;
+    as.capacity = capacity;
+
+    for (as.pass = 1; as.pass <= 2 && !as.errors; as.pass++) {
+        const char *line = source;
+
+        as.line = 0;
+        as.size = 0;
+
+        while (*line) {
+            char text[ASSEMBLER_MAX_LINE_LENGTH];
+            size_t length = strcspn(line, "\n");
+
+            as.line++;
+            if (length >= sizeof(text)) {
+                error(&as, "line too long%s", "");
+            } else {
+                memcpy(text, line, length);
+                text[length] = '\0';
+                assemble_line(&as, text);
+            }
+
+            line += length + (line[length] == '\n');
+        }
+    }
+
+    return as.errors ? -1 : as.size;
+}
+
+/**
+ * Assemble a line: an optional label followed by an optional statement.
+ */
+static void assemble_line(assembler_t *as, char *text) {
+    char *operands[MAX_VALUES];
+    int count = 0;
+
+    // comments run to the end of the line
+    text[strcspn(text, ";")] = '\0';
+    text = trim(text);
+
+    char *colon = strchr(text, ':');
+    if (colon != NULL) {
+        *colon = '\0';
+        char *name = trim(text);
+        text = trim(colon + 1);
+
+        size_t length = strlen(name);
+        int valid = length > 0 && length < ASSEMBLER_MAX_LABEL_LENGTH && (isalpha((unsigned char) name[0]) || name[0] == '_');
+        for (size_t i = 0; i < length; i++) {
+            valid &= isalnum((unsigned char) name[i]) || name[i] == '_' || name[i] == '.';
+        }
+
+        if (!valid || register_index(name) >= 0 || is_keyword(name, length)) {
+            error(as, "invalid label '%s'", name);
+        } else if (as->pass == 1) {
+            if (find_label(as, name, length) != NULL) {
+                error(as, "duplicate label '%s'", name);
+            } else if (as->count == ASSEMBLER_MAX_LABELS) {
+                error(as, "too many labels%s", "");
+            } else {
+                strcpy(as->labels[as->count].name, name);
+                as->labels[as->count++].address = MEMORY_PGM_START + as->size;
+            }
+        }
+    }
+
+    if (*text == '\0') {
+        return;
+    }
+
+    // the mnemonic ends at the first blank, the operands are separated by commas
+    char *mnemonic = text;
+    char *rest = text + strcspn(text, " \t");
+    if (*rest != '\0') {
+        *rest++ = '\0';
+        rest = trim(rest);
+    }
+
+    while (*rest != '\0' && count < MAX_VALUES) {
+        char *comma = strchr(rest, ',');
+
+        if (comma != NULL) {
+            *comma = '\0';
+        }
+
+        operands[count++] = trim(rest);
+        rest = comma != NULL ? comma + 1 : rest + strlen(rest);
+    }
+
+    if (*rest != '\0') {
+        error(as, "too many operands for '%s'", mnemonic);
+    } else if (!strcasecmp(mnemonic, "db") || !strcasecmp(mnemonic, "dw")) {
+        assemble_data(as, tolower(mnemonic[1]) == 'b' ? 1 : 2, operands, count);
+    } else if (count > MAX_OPERANDS) {
+        error(as, "too many operands for '%s'", mnemonic);
+    } else {
+        assemble_instruction(as, mnemonic, operands, count);
+    }
+}
+
+/**
+ * Find the form that matches the operands and emit its opcode.
+ */
+static void assemble_instruction(assembler_t *as, const char *mnemonic, char **operands, int count) {
+    int errors = as->errors;
+    int known = 0;
+
+    for (size_t f = 0; f < NUM_FORMS; f++) {
+        const form_t *form = &forms[f];
+        uint16_t opcode = form->opcode;
+        int matched = 1;
+        int i;
+
+        if (strcasecmp(form->mnemonic, mnemonic)) {
+            continue;
+        }
+
+        known = 1;
+        for (i = 0; i < MAX_OPERANDS && form->operands[i] != NONE && matched; i++) {
+            int value, reg = i < count ? register_index(operands[i]) : -1;
+
+            if (i >= count) {
+                matched = 0;
+                continue;
+            }
+
+            switch (form->operands[i]) {
+                case REGISTER_X:
+                    matched = reg >= 0;
+                    if (matched) {
+                        opcode |= reg << 8;
+                    }
+                    break;
+                case REGISTER_Y:
+                    matched = reg >= 0;
+                    if (matched) {
+                        opcode |= reg << 4;
+                    }
+                    break;
+                case REGISTER_0:
+                    matched = reg == 0;
+                    break;
+                case ADDRESS:
+                case BYTE:
+                case NIBBLE: {
+                    int limit = form->operands[i] == ADDRESS ? 0xFFF : form->operands[i] == BYTE ? 0xFF : 0xF;
+
+                    matched = reg < 0 && evaluate(as, operands[i], &value);
+
+                    // labels are only known in the second pass
+                    if (matched && as->pass == 2 && (value < 0 || value > limit)) {
+                        // negative bytes are accepted as two's complement (ADD V0, -1)
+                        if (form->operands[i] == BYTE && value >= -0x80 && value < 0) {
+                            value &= 0xFF;
+                        } else {
+                            error(as, "value out of range: '%s'", operands[i]);
+                            return;
+                        }
+                    }
+
+                    if (matched) {
+                        opcode |= value & limit;
+                    }
+                    break;
+                }
+                default:
+                    matched = !strcasecmp(operands[i], keywords[form->operands[i]]);
+                    break;
+            }
+        }
+
+        if (matched && i == count) {
+            emit(as, opcode >> 8);
+            emit(as, opcode & 0xFF);
+            return;
+        }
+    }
+
+    // an unknown label is already reported by evaluate
+    if (as->errors == errors) {
+        error(as, known ? "invalid operands for '%s'" : "unknown instruction '%s'", mnemonic);
+    }
+}
+
+/**
+ * Emit the operands of a db (width 1) or dw (width 2) directive.
+ */
+static void assemble_data(assembler_t *as, int width, char **operands, int count) {
+    int limit = width == 1 ? 0xFF : 0xFFFF;
+
+    for (int i = 0; i < count; i++) {
+        int value;
+
+        if (!evaluate(as, operands[i], &value)) {
+            error(as, "invalid value '%s'", operands[i]);
+            return;
+        } else if (as->pass == 2 && (value < -(limit + 1) / 2 || value > limit)) {
+            error(as, "value out of range: '%s'", operands[i]);
+            return;
+        }
+
+        if (width == 2) {
+            emit(as, (value >> 8) & 0xFF);
+        }
+        emit(as, value & 0xFF);
+    }
+}
+
+/**
+ * Evaluate a sum of numbers and labels. Unknown labels are
+ * an error in the second pass and evaluate to 0 in the first one.
+ *
+ * @return 1 if the text is a valid expression, 0 otherwise
+ */
+static int evaluate(assembler_t *as, const char *text, int *value) {
+    const char *p = text;
+    int sign = 1;
+
+    *value = 0;
+
+    if (*p == '-') {
+        sign = -1;
+        p++;
+    }
+
+    while (1) {
+        int term = 0;
+
+        if (isdigit((unsigned char) *p)) {
+            int base = 10;
+
+            if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+                base = 16;
+                p += 2;
+            } else if (p[0] == '0' && (p[1] == 'b' || p[1] == 'B')) {
+                base = 2;
+                p += 2;
+            }
+
+            const char *start = p;
+            while (isxdigit((unsigned char) *p)) {
+                int digit = isdigit((unsigned char) *p) ? *p - '0' : tolower(*p) - 'a' + 10;
+
+                if (digit >= base || term > 0xFFFF) {
+                    return 0;
+                }
+
+                term = term * base + digit;
+                p++;
+            }
+
+            if (p == start) {
+                return 0;
+            }
+        } else if (isalpha((unsigned char) *p) || *p == '_') {
+            const char *start = p;
+
+            while (isalnum((unsigned char) *p) || *p == '_' || *p == '.') {
+                p++;
+            }
+
+            const label_t *label = find_label(as, start, p - start);
+            if (is_keyword(start, p - start)) {
+                return 0;
+            } else if (label != NULL) {
+                term = label->address;
+            } else if (as->pass == 2) {
+                char name[ASSEMBLER_MAX_LABEL_LENGTH];
+
+                snprintf(name, sizeof(name), "%.*s", (int) (p - start), start);
+                error(as, "unknown label '%s'", name);
+                return 0;
+            }
+        } else {
+            return 0;
+        }
+
+        *value += sign * term;
+
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+
+        if (*p == '\0') {
+            return 1;
+        } else if (*p != '+' && *p != '-') {
+            return 0;
+        }
+
+        sign = *p++ == '+' ? 1 : -1;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+    }
+}
+
+/**
+ * @return the index of the register named by the text, or -1 if it is not a register
+ */
+static int register_index(const char *text) {
+    if ((text[0] != 'V' && text[0] != 'v') || !isxdigit((unsigned char) text[1]) || text[2] != '\0') {
+        return -1;
+    }
+
+    return isdigit((unsigned char) text[1]) ? text[1] - '0' : tolower(text[1]) - 'a' + 10;
+}
+
+/**
+ * @return 1 if the name is a keyword operand (I, DT, ST, K, F, B), 0 otherwise
+ */
+static int is_keyword(const char *name, size_t length) {
+    for (int kind = KEYWORD_I; kind < NONE; kind++) {
+        if (strlen(keywords[kind]) == length && !strncasecmp(keywords[kind], name, length)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Look up a label by name
+ */
+static const label_t *find_label(const assembler_t *as, const char *name, size_t length) {
+    for (int i = 0; i < as->count; i++) {
+        if (strlen(as->labels[i].name) == length && !strncmp(as->labels[i].name, name, length)) {
+            return &as->labels[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Append a byte to the program. Only the second pass writes it.
+ */
+static void emit(assembler_t *as, uint8_t byte) {
+    if (as->size >= as->capacity) {
+        // reported once, at the first byte that does not fit
+        if (as->size++ == as->capacity) {
+            error(as, "the program does not fit in memory%s", "");
+        }
+
+        return;
+    }
+
+    if (as->pass == 2) {
+        as->program[as->size] = byte;
+    }
+
+    as->size++;
+}
+
+/**
+ * Report an error at the current line
+ */
+static void error(assembler_t *as, const char *format, const char *argument) {
+    fprintf(stderr, "Assembler error at line %d: ", as->line);
+    fprintf(stderr, format, argument);
+    fprintf(stderr, "\n");
+
+    as->errors++;
+}
+
+/**
+ * Remove the blanks around a string
+ */
+static char *trim(char *text) {
+    while (isspace((unsigned char) *text)) {
+        text++;
+    }
+
+    size_t length = strlen(text);
+    while (length > 0 && isspace((unsigned char) text[length - 1])) {
+        text[--length] = '\0';
+    }
+
+    return text;
+}
+
+int disassemble_instruction(uint16_t opcode, char *text, size_t size) {
+    for (size_t f = 0; f < NUM_FORMS; f++) {
+        const form_t *form = &forms[f];
+        uint16_t mask = 0xFFFF;
+        int i;
+
+        // the bits of the operands are not part of the form
+        for (i = 0; i < MAX_OPERANDS && form->operands[i] != NONE; i++) {
+            switch (form->operands[i]) {
+                case REGISTER_X:
+                    mask &= ~0x0F00;
+                    break;
+                case REGISTER_Y:
+                    mask &= ~0x00F0;
+                    break;
+                case ADDRESS:
+                    mask &= ~0x0FFF;
+                    break;
+                case BYTE:
+                    mask &= ~0x00FF;
+                    break;
+                case NIBBLE:
+                    mask &= ~0x000F;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if ((opcode & mask) != form->opcode) {
+            continue;
+        }
+
+        char line[32];
+        int length = snprintf(line, sizeof(line), "%s", form->mnemonic);
+
+        for (i = 0; i < MAX_OPERANDS && form->operands[i] != NONE; i++) {
+            const char *separator = i == 0 ? " " : ", ";
+            char *end = line + length;
+            size_t left = sizeof(line) - length;
+
+            switch (form->operands[i]) {
+                case REGISTER_X:
+                    length += snprintf(end, left, "%sV%X", separator, (opcode >> 8) & 0xF);
+                    break;
+                case REGISTER_Y:
+                    length += snprintf(end, left, "%sV%X", separator, (opcode >> 4) & 0xF);
+                    break;
+                case REGISTER_0:
+                    length += snprintf(end, left, "%sV0", separator);
+                    break;
+                case ADDRESS:
+                    length += snprintf(end, left, "%s0x%03X", separator, opcode & 0xFFF);
+                    break;
+                case BYTE:
+                    length += snprintf(end, left, "%s0x%02X", separator, opcode & 0xFF);
+                    break;
+                case NIBBLE:
+                    length += snprintf(end, left, "%s%d", separator, opcode & 0xF);
+                    break;
+                default:
+                    length += snprintf(end, left, "%s%s", separator, keywords[form->operands[i]]);
+                    break;
+            }
+        }
+
+        snprintf(text, size, "%s", line);
+        return 1;
+    }
+
+    snprintf(text, size, "dw 0x%04X", opcode);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "CHIP-8.h"
+
+/**
+ * Maximum size of an assembled program: the memory from MEMORY_PGM_START on
+ */
+#define ASSEMBLER_MAX_SIZE (4096 - MEMORY_PGM_START)
+
+#define ASSEMBLER_MAX_LABELS 512
+#define ASSEMBLER_MAX_LABEL_LENGTH 32
+#define ASSEMBLER_MAX_LINE_LENGTH 256
+
+/**
+ * Assemble a CHIP-8 program loaded at MEMORY_PGM_START.
+ *
+ * The source has one statement per line, with the mnemonics of the
+ * technical reference (see instructions.h), case insensitive:
+ *
+ *     loop:               ; a label, followed by an optional statement
+ *         LD V0, 0x10     ; operands are separated by commas
+ *         LD I, sprite
+ *         DRW V0, V1, 5
+ *         JP loop
+ *     sprite:
+ *         db 0xF0, 0x90, 0b10010000, 144, 0xF0
+ *
+ * Numbers are decimal, hexadecimal (0x) or binary (0b). Wherever a number
+ * is expected, a label or a sum of labels and numbers (label+1) can be
+ * used. The directives db and dw emit bytes and big-endian words.
+ * SHR and SHL accept one or two registers.
+ *
+ * Errors are reported on stderr with their line number.
+ *
+ * @param source is the text of the program, NUL-terminated
+ * @param program receives the assembled bytes
+ * @param capacity is the size of program in bytes
+ * @return the size of the program in bytes, or -1 if the source has errors
+ */
+extern int assemble_program(const char *source, uint8_t *program, int capacity);
+
+/**
+ * Disassemble an opcode with the mnemonics accepted by assemble_program
+ * (DRW VA, VB, 6). Opcodes that are not instructions are written as a
+ * dw directive.
+ *
+ * @param opcode is the opcode to disassemble
+ * @param text receives the NUL-terminated statement
+ * @param size is the size of text in bytes
+ * @return 1 if the opcode is an instruction, 0 otherwise
+ */
+extern int disassemble_instruction(uint16_t opcode, char *text, size_t size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "block_cache.h"
+#include "instructions.h"
+#include "superinstructions.h"
+
+static block_t *decode_block(CHIP8 *chip8, uint16_t address, int fuse);
+
+static void decode_op(CHIP8 *chip8, decoded_op_t *op, uint16_t address);
+
+static int is_skip(instruction_runner execute);
+
+static int ends_block(instruction_runner execute);
+
+static void discard_block(block_cache_t *cache, uint16_t start);
+
+
+block_cache_t *block_cache_create(int fuse) {
+    block_cache_t *cache = calloc(1, sizeof(block_cache_t));
+
+    if (cache != NULL) {
+        cache->fuse = fuse;
+    }
+
+    return cache;
+}
+
+void block_cache_destroy(block_cache_t *cache) {
+    for (int i = 0; i < MEMORY_SIZE; i++) {
+        free(cache->blocks[i]);
+    }
+
+    free(cache);
+}
+
+block_t *block_cache_fetch(block_cache_t *cache, CHIP8 *chip8, uint16_t address) {
+    address &= MEMORY_SIZE - 1;
+
+    block_t *block = cache->blocks[address];
+    if (block != NULL) {
+        return block;
+    }
+
+    block = decode_block(chip8, address, cache->fuse);
+    if (!block) {
+        fprintf(stderr, "Unable to allocate a block! Aborting...\n");
+        exit(1);
+    }
+
+    for (uint16_t i = block->start; i < block->decoded_end; i++) {
+        cache->coverage[i]++;
+    }
+
+    cache->blocks[address] = block;
+    return block;
+}
+
+void block_cache_invalidate(block_cache_t *cache, uint16_t address, uint16_t length) {
+    for (uint32_t a = address; a < (uint32_t) address + length && a < MEMORY_SIZE; a++) {
+        if (!cache->coverage[a]) {
+            continue;
+        }
+
+        // a block covering a starts at most 2 * (BLOCK_MAX_LENGTH + BLOCK_MAX_TAIL) - 1 bytes before it
+        int first = (int) a - (2 * (BLOCK_MAX_LENGTH + BLOCK_MAX_TAIL) - 1);
+        for (int start = first < 0 ? 0 : first; start <= (int) a; start++) {
+            block_t *block = cache->blocks[start];
+
+            if (block != NULL && a < block->decoded_end) {
+                discard_block(cache, start);
+            }
+        }
+    }
+}
+
+/**
+ * Decode the instructions starting at the given address
+ * until the end of the basic block.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param address is the start address of the block
+ * @param fuse is nonzero to replace instruction sequences with superinstructions
+ * @return the new block, or NULL if the allocation failed
+ */
+static block_t *decode_block(CHIP8 *chip8, uint16_t address, int fuse) {
+    block_t *block = malloc(sizeof(block_t));
+    if (!block) {
+        return NULL;
+    }
+
+    block->start = address;
+    block->length = 0;
+    block->executions = 0;
+    block->native = NULL;
+
+    uint16_t pc = address;
+    do {
+        decoded_op_t *op = &block->ops[block->length++];
+        decode_op(chip8, op, pc);
+
+        pc += 2;
+
+        if (ends_block(op->execute)) {
+            break;
+        }
+    } while (block->length < BLOCK_MAX_LENGTH && pc + 1 < MEMORY_SIZE);
+
+    block->end = pc < MEMORY_SIZE ? pc : MEMORY_SIZE;
+
+    // decode the path taken when the final skip does not skip
+    int tail = 0;
+    if (fuse && is_skip(block->ops[block->length - 1].execute)) {
+        for (; tail < BLOCK_MAX_TAIL && pc + 1 < MEMORY_SIZE; tail++, pc += 2) {
+            decode_op(chip8, &block->ops[block->length + tail], pc);
+        }
+    }
+
+    block->decoded_end = pc < MEMORY_SIZE ? pc : MEMORY_SIZE;
+
+    for (int i = 0; i < block->length; i++) {
+        block->fused[i] = NULL;
+    }
+
+    for (int i = 0; fuse && i < block->length;) {
+        int length;
+        superinstruction_runner run = superinstruction_match(&block->ops[i], block->length + tail - i, &length);
+
+        if (run != NULL) {
+            block->fused[i] = run;
+            block->fused_length[i] = length;
+            i += length;
+        } else {
+            i++;
+        }
+    }
+
+    return block;
+}
+
+/**
+ * Decode the instruction at the given address.
+ */
+static void decode_op(CHIP8 *chip8, decoded_op_t *op, uint16_t address) {
+    uint16_t opcode = (chip8->memory[address] << 8) | chip8->memory[(address + 1) & (MEMORY_SIZE - 1)];
+
+    op->execute = CHIP8_decode(chip8, opcode);
+    op->opcode = opcode;
+    op->nnn = opcode & 0x0FFF;
+    op->kk = opcode & 0x00FF;
+    op->x = (opcode & 0x0F00) >> 8;
+    op->y = (opcode & 0x00F0) >> 4;
+}
+
+/**
+ * Check whether an instruction is a conditional skip
+ */
+static int is_skip(instruction_runner execute) {
+    return execute == &skip_equal_imm
+           || execute == &skip_not_equal_imm
+           || execute == &skip_equal_reg
+           || execute == &skip_ne_reg
+           || execute == &skip_if_pressed
+           || execute == &skip_if_not_pressed;
+}
+
+/**
+ * Check whether an instruction terminates a basic block, that is
+ * if it may change the program counter or write to main memory.
+ *
+ * @param execute is the function that executes the instruction
+ */
+static int ends_block(instruction_runner execute) {
+    return execute == &ret
+           || execute == &jump_immediate
+           || execute == &call
+           || execute == &skip_equal_imm
+           || execute == &skip_not_equal_imm
+           || execute == &skip_equal_reg
+           || execute == &skip_ne_reg
+           || execute == &jump_addr
+           || execute == &skip_if_pressed
+           || execute == &skip_if_not_pressed
+           || execute == &load_key
+           || execute == &load_bcd_representation
+           || execute == &store_registers;
+}
+
+/**
+ * Remove a block from the cache and release it.
+ *
+ * @param cache is a pointer to the cache
+ * @param start is the start address of the block
+ */
+static void discard_block(block_cache_t *cache, uint16_t start) {
+    block_t *block = cache->blocks[start];
+
+    for (uint16_t i = block->start; i < block->decoded_end; i++) {
+        cache->coverage[i]--;
+    }
+
+    cache->blocks[start] = NULL;
+    free(block);
+}
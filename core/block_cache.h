@@ -0,0 +1,130 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stdint.h>
+#include "CHIP-8.h"
+
+#define MEMORY_SIZE 4096
+
+/**
+ * Maximum number of instructions in a basic block
+ */
+#define BLOCK_MAX_LENGTH 32
+
+/**
+ * Maximum number of instructions decoded past a final skip,
+ * so that superinstructions can extend into the not-skipped path
+ */
+#define BLOCK_MAX_TAIL 2
+
+/**
+ * An instruction decoded once when its block is built:
+ * the function that executes it and its operands.
+ */
+struct decoded_op_s {
+    instruction_runner execute;
+    uint16_t opcode;
+
+    // operands extracted from the opcode
+    uint16_t nnn;
+    uint8_t kk;
+    uint8_t x;
+    uint8_t y;
+};
+
+typedef struct decoded_op_s decoded_op_t;
+
+/**
+ * Function that executes a superinstruction: a sequence of instructions
+ * fused into a single dispatch.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param ops are the instructions of the sequence
+ * @return the number of instructions executed, which is lower than the
+ *         length of the sequence when an instruction changes the PC
+ */
+typedef int (*superinstruction_runner)(CHIP8 *chip8, const decoded_op_t *ops);
+
+/**
+ * A basic block: a straight sequence of instructions that ends
+ * with the first instruction that may change the program counter
+ * (jumps, calls, returns, skips, key waits) or write to main memory.
+ */
+struct block_s {
+    // the block covers the addresses [start, end)
+    uint16_t start;
+    uint16_t end;
+
+    // the decoded instructions, including the tail, cover [start, decoded_end)
+    uint16_t decoded_end;
+
+    uint8_t length;
+    decoded_op_t ops[BLOCK_MAX_LENGTH + BLOCK_MAX_TAIL];
+
+    // superinstruction starting at each instruction, NULL if none
+    superinstruction_runner fused[BLOCK_MAX_LENGTH];
+    uint8_t fused_length[BLOCK_MAX_LENGTH];
+
+    // number of executions, used by the JIT to find hot blocks
+    uint32_t executions;
+
+    // native translation of the block, NULL if not compiled
+    void (*native)(CHIP8 *chip8);
+};
+
+typedef struct block_s block_t;
+
+/**
+ * Cache of decoded blocks, indexed by their start address.
+ */
+struct block_cache_s {
+    block_t *blocks[MEMORY_SIZE];
+
+    /**
+     * Number of cached blocks that cover each memory address.
+     * Writes to addresses not covered by any block are ignored
+     * without looking up the blocks.
+     */
+    uint8_t coverage[MEMORY_SIZE];
+
+    // nonzero if the blocks are built with superinstructions
+    int fuse;
+};
+
+typedef struct block_cache_s block_cache_t;
+
+/**
+ * Allocate an empty block cache.
+ *
+ * @param fuse is nonzero to build blocks with superinstructions
+ * @return the cache, or NULL if the allocation failed
+ */
+extern block_cache_t *block_cache_create(int fuse);
+
+/**
+ * Release a block cache and all its blocks.
+ *
+ * @param cache is a pointer to the cache
+ */
+extern void block_cache_destroy(block_cache_t *cache);
+
+/**
+ * Return the block starting at the given address,
+ * decoding it from the emulator memory if it is not cached.
+ *
+ * @param cache is a pointer to the cache
+ * @param chip8 is a pointer to the emulator
+ * @param address is the start address of the block
+ */
+extern block_t *block_cache_fetch(block_cache_t *cache, CHIP8 *chip8, uint16_t address);
+
+/**
+ * Discard every cached block that covers at least one of the given addresses.
+ *
+ * @param cache is a pointer to the cache
+ * @param address is the first modified address
+ * @param length is the number of modified bytes
+ */
+extern void block_cache_invalidate(block_cache_t *cache, uint16_t address, uint16_t length);
+
+#endif
@@ -0,0 +1,228 @@
+#include <string.h>
+#include "debugger.h"
+
+/**
+ * Stop when PC returns to until with the stack at the given depth;
+ * no stop is requested with until = -1
+ */
+static debug_stop run_checked(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed,
+                              int until, uint8_t depth);
+
+static int breakpoint_hit(debugger_t *debugger, const CHIP8 *chip8);
+
+static int condition_holds(const debug_condition_t *condition, const CHIP8 *chip8);
+
+static int key_wait(const CHIP8 *chip8);
+
+
+void debugger_init(debugger_t *debugger) {
+    memset(debugger, 0, sizeof(debugger_t));
+    debugger->breakpoint = -1;
+}
+
+int debugger_add_breakpoint(debugger_t *debugger, uint16_t address, const debug_condition_t *condition) {
+    for (int i = 0; i < DEBUGGER_MAX_BREAKPOINTS; i++) {
+        breakpoint_t *breakpoint = &debugger->breakpoints[i];
+
+        if (breakpoint->active) {
+            continue;
+        }
+
+        breakpoint->address = address & 0xFFF;
+        breakpoint->condition = condition != NULL ? *condition : (debug_condition_t) {0, DEBUG_ALWAYS, 0};
+        breakpoint->active = 1;
+        breakpoint->hits = 0;
+
+        debugger->armed[breakpoint->address]++;
+        debugger->breakpoint_count++;
+        return i;
+    }
+
+    return -1;
+}
+
+int debugger_remove_breakpoint(debugger_t *debugger, int index) {
+    if (index < 0 || index >= DEBUGGER_MAX_BREAKPOINTS || !debugger->breakpoints[index].active) {
+        return 0;
+    }
+
+    debugger->breakpoints[index].active = 0;
+    debugger->armed[debugger->breakpoints[index].address]--;
+    debugger->breakpoint_count--;
+    return 1;
+}
+
+void debugger_watch_memory(debugger_t *debugger, uint16_t address, uint16_t length, int enabled) {
+    for (uint32_t a = address; a < (uint32_t) address + length && a < 4096; a++) {
+        if (debugger->watched[a] != !!enabled) {
+            debugger->watch_count += enabled ? 1 : -1;
+            debugger->watched[a] = !!enabled;
+        }
+    }
+}
+
+void debugger_watch_I(debugger_t *debugger, int enabled) {
+    debugger->watch_I = enabled;
+}
+
+int debugger_armed(const debugger_t *debugger) {
+    return debugger->breakpoint_count || debugger->watch_count || debugger->watch_I;
+}
+
+debug_stop debugger_run(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed) {
+    if (debugger_armed(debugger)) {
+        return run_checked(debugger, chip8, cycles, executed, -1, 0);
+    }
+
+    // nothing to check: the engine runs at full speed, the last cycles are ticked to stop exactly at cycles
+    uint64_t count = 0;
+
+    while (count < cycles) {
+        if (cycles - count > CHIP8_MAX_STEP_CYCLES) {
+            count += CHIP8_step(chip8);
+        } else {
+            CHIP8_tick(chip8);
+            count++;
+        }
+
+        if (key_wait(chip8)) {
+            *executed = count;
+            return DEBUG_STOP_KEY_WAIT;
+        }
+    }
+
+    *executed = count;
+    return DEBUG_STOP_BUDGET;
+}
+
+debug_stop debugger_step(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed) {
+    debug_stop stop = run_checked(debugger, chip8, cycles, executed, -1, 0);
+
+    return stop == DEBUG_STOP_BUDGET ? DEBUG_STOP_STEP : stop;
+}
+
+debug_stop debugger_step_over(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed) {
+    uint16_t opcode = (chip8->memory[chip8->PC & 0xFFF] << 8) | chip8->memory[(chip8->PC + 1) & 0xFFF];
+
+    if (chip8->waiting_key || (opcode & 0xF000) != 0x2000) {
+        return debugger_step(debugger, chip8, 1, executed);
+    }
+
+    return run_checked(debugger, chip8, cycles, executed, chip8->PC + 2, chip8->SP);
+}
+
+static debug_stop run_checked(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed,
+                              int until, uint8_t depth) {
+    uint64_t count;
+
+    debugger->breakpoint = -1;
+
+    for (count = 0; count < cycles; count++) {
+        uint16_t written = 0, length = 0;
+        uint16_t I = chip8->I;
+
+        if (!chip8->waiting_key) {
+            // the instruction of the stop is executed when the emulator resumes
+            if (count > 0 && chip8->PC == until && chip8->SP == depth) {
+                *executed = count;
+                return DEBUG_STOP_STEP;
+            }
+
+            if (count > 0 && debugger->armed[chip8->PC & 0xFFF] && breakpoint_hit(debugger, chip8)) {
+                *executed = count;
+                return DEBUG_STOP_BREAKPOINT;
+            }
+
+            uint16_t opcode = (chip8->memory[chip8->PC & 0xFFF] << 8) | chip8->memory[(chip8->PC + 1) & 0xFFF];
+
+            // the only instructions that write to memory: Fx33 and Fx55
+            if ((opcode & 0xF0FF) == 0xF033) {
+                written = I;
+                length = 3;
+            } else if ((opcode & 0xF0FF) == 0xF055) {
+                written = I;
+                length = ((opcode >> 8) & 0xF) + 1;
+            }
+        }
+
+        CHIP8_tick(chip8);
+
+        for (uint32_t a = written; a < (uint32_t) written + length && debugger->watch_count; a++) {
+            if (debugger->watched[a & 0xFFF]) {
+                debugger->watch_address = a & 0xFFF;
+                *executed = count + 1;
+                return DEBUG_STOP_WATCH_MEMORY;
+            }
+        }
+
+        if (debugger->watch_I && chip8->I != I) {
+            debugger->previous_I = I;
+            *executed = count + 1;
+            return DEBUG_STOP_WATCH_I;
+        }
+
+        if (key_wait(chip8)) {
+            *executed = count + 1;
+            return DEBUG_STOP_KEY_WAIT;
+        }
+    }
+
+    *executed = count;
+    return DEBUG_STOP_BUDGET;
+}
+
+/**
+ * Check the conditions of the breakpoints at PC, and remember the first one that holds
+ */
+static int breakpoint_hit(debugger_t *debugger, const CHIP8 *chip8) {
+    for (int i = 0; i < DEBUGGER_MAX_BREAKPOINTS; i++) {
+        breakpoint_t *breakpoint = &debugger->breakpoints[i];
+
+        if (breakpoint->active && breakpoint->address == (chip8->PC & 0xFFF)
+            && condition_holds(&breakpoint->condition, chip8)) {
+            breakpoint->hits++;
+            debugger->breakpoint = i;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int condition_holds(const debug_condition_t *condition, const CHIP8 *chip8) {
+    uint16_t value;
+
+    if (condition->operand < 16) {
+        value = chip8->register_file.raw[condition->operand];
+    } else if (condition->operand == DEBUG_OPERAND_I) {
+        value = chip8->I;
+    } else if (condition->operand == DEBUG_OPERAND_DT) {
+        value = chip8->delay_timer;
+    } else {
+        value = chip8->sound_timer;
+    }
+
+    switch (condition->comparison) {
+        case DEBUG_EQUAL:
+            return value == condition->value;
+        case DEBUG_NOT_EQUAL:
+            return value != condition->value;
+        case DEBUG_LESS:
+            return value < condition->value;
+        case DEBUG_LESS_EQUAL:
+            return value <= condition->value;
+        case DEBUG_GREATER:
+            return value > condition->value;
+        case DEBUG_GREATER_EQUAL:
+            return value >= condition->value;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * A CPU waiting for a key that is not down cannot make progress without the user
+ */
+static int key_wait(const CHIP8 *chip8) {
+    return chip8->waiting_key && !(chip8->keys | chip8->key_presses);
+}
\ No newline at end of file
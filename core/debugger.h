@@ -0,0 +1,185 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include "CHIP-8.h"
+
+#define DEBUGGER_MAX_BREAKPOINTS 64
+
+/**
+ * Operands of a breakpoint condition: V0-VF are 0-15
+ */
+#define DEBUG_OPERAND_I 16
+#define DEBUG_OPERAND_DT 17
+#define DEBUG_OPERAND_ST 18
+
+enum debug_comparison_e {
+    DEBUG_ALWAYS,
+    DEBUG_EQUAL,
+    DEBUG_NOT_EQUAL,
+    DEBUG_LESS,
+    DEBUG_LESS_EQUAL,
+    DEBUG_GREATER,
+    DEBUG_GREATER_EQUAL
+};
+
+typedef enum debug_comparison_e debug_comparison;
+
+/**
+ * Reasons for the debugger to give control back
+ *  - DEBUG_STOP_BUDGET: the given number of cycles was executed
+ *  - DEBUG_STOP_STEP: the step (or the call stepped over) completed
+ *  - DEBUG_STOP_BREAKPOINT: PC reached a breakpoint whose condition holds,
+ *    the instruction at the breakpoint is not executed yet
+ *  - DEBUG_STOP_WATCH_MEMORY, DEBUG_STOP_WATCH_I: the last instruction
+ *    wrote a watched address or changed I
+ *  - DEBUG_STOP_KEY_WAIT: the CPU waits for a key and none is down
+ */
+enum debug_stop_e {
+    DEBUG_STOP_BUDGET,
+    DEBUG_STOP_STEP,
+    DEBUG_STOP_BREAKPOINT,
+    DEBUG_STOP_WATCH_MEMORY,
+    DEBUG_STOP_WATCH_I,
+    DEBUG_STOP_KEY_WAIT
+};
+
+typedef enum debug_stop_e debug_stop;
+
+/**
+ * A breakpoint stops when operand comparison value holds (V3 == 5)
+ */
+struct debug_condition_s {
+    uint8_t operand;
+    debug_comparison comparison;
+    uint16_t value;
+};
+
+typedef struct debug_condition_s debug_condition_t;
+
+struct breakpoint_s {
+    uint16_t address;
+    debug_condition_t condition;
+    uint8_t active;
+    uint64_t hits;
+};
+
+typedef struct breakpoint_s breakpoint_t;
+
+/**
+ * Breakpoints and watchpoints of an emulator.
+ *
+ * The emulator does not know about the debugger: the debugger runs it
+ * in place of CHIP8_step. While nothing is armed the debugger runs the
+ * selected engine; otherwise it swaps in its own loop, which executes
+ * one instruction at a time with CHIP8_tick and checks the breakpoints
+ * and watchpoints around it. The normal execution path has no checks.
+ *
+ * Memory watchpoints see the writes of the program (Fx33 and Fx55),
+ * not the writes of the frontend. The idle loops are not fast-forwarded
+ * while the debugger checks the instructions.
+ */
+struct debugger_s {
+    breakpoint_t breakpoints[DEBUGGER_MAX_BREAKPOINTS];
+
+    // active breakpoints at each address, and in total
+    uint8_t armed[4096];
+    int breakpoint_count;
+
+    // watched addresses, number of watched addresses, and watch of I
+    uint8_t watched[4096];
+    int watch_count;
+    int watch_I;
+
+    // breakpoint of the last stop, address of the watched write and previous value of I
+    int breakpoint;
+    uint16_t watch_address;
+    uint16_t previous_I;
+};
+
+typedef struct debugger_s debugger_t;
+
+/**
+ * @param debugger is a pointer to the debugger, left without breakpoints and watchpoints
+ */
+extern void debugger_init(debugger_t *debugger);
+
+/**
+ * Add a breakpoint.
+ *
+ * @param debugger is a pointer to the debugger
+ * @param address is the address of the instruction
+ * @param condition is the condition, NULL to always stop
+ * @return the index of the breakpoint, -1 if there are too many breakpoints
+ */
+extern int debugger_add_breakpoint(debugger_t *debugger, uint16_t address, const debug_condition_t *condition);
+
+/**
+ * @param debugger is a pointer to the debugger
+ * @param index is the index of the breakpoint
+ * @return 1 on success, 0 if there is no such breakpoint
+ */
+extern int debugger_remove_breakpoint(debugger_t *debugger, int index);
+
+/**
+ * Start or stop watching the writes to a memory range.
+ *
+ * @param debugger is a pointer to the debugger
+ * @param address is the first address of the range
+ * @param length is the number of bytes of the range
+ * @param enabled is nonzero to watch the range, zero to stop watching it
+ */
+extern void debugger_watch_memory(debugger_t *debugger, uint16_t address, uint16_t length, int enabled);
+
+/**
+ * @param debugger is a pointer to the debugger
+ * @param enabled is nonzero to stop when I changes, zero otherwise
+ */
+extern void debugger_watch_I(debugger_t *debugger, int enabled);
+
+/**
+ * @param debugger is a pointer to the debugger
+ * @return nonzero if a breakpoint or a watchpoint is active
+ */
+extern int debugger_armed(const debugger_t *debugger);
+
+/**
+ * Run the emulator until a breakpoint or a watchpoint is hit. The
+ * instruction at PC is executed even if it has a breakpoint, so that
+ * the emulator can be resumed after a stop.
+ *
+ * @param debugger is a pointer to the debugger
+ * @param chip8 is a pointer to the emulator
+ * @param cycles is the maximum number of cycles
+ * @param executed receives the number of cycles executed
+ * @return the reason of the stop
+ */
+extern debug_stop debugger_run(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed);
+
+/**
+ * Execute the given number of cycles one instruction at a time. The
+ * breakpoints after the first instruction and the watchpoints are
+ * reported; DEBUG_STOP_STEP is returned once all the cycles are executed.
+ *
+ * @param debugger is a pointer to the debugger
+ * @param chip8 is a pointer to the emulator
+ * @param cycles is the number of cycles
+ * @param executed receives the number of cycles executed
+ * @return the reason of the stop
+ */
+extern debug_stop debugger_step(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed);
+
+/**
+ * Execute a single cycle, or a whole subroutine if PC is at a CALL: the
+ * emulator stops after the CALL, when the subroutine returns (or earlier
+ * on a breakpoint or a watchpoint).
+ *
+ * @param debugger is a pointer to the debugger
+ * @param chip8 is a pointer to the emulator
+ * @param cycles is the maximum number of cycles
+ * @param executed receives the number of cycles executed
+ * @return the reason of the stop
+ */
+extern debug_stop debugger_step_over(debugger_t *debugger, CHIP8 *chip8, uint64_t cycles, uint64_t *executed);
+
+#endif
\ No newline at end of file
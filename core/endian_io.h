@@ -0,0 +1,42 @@
+#ifndef ENDIAN_IO_H
+#define ENDIAN_IO_H
+
+#include <stdint.h>
+
+/**
+ * Little-endian encoding of the integers in the files and images
+ * written by the core (save states, recordings), independent of the
+ * byte order of the host.
+ */
+
+/**
+ * Write a value in little-endian order.
+ *
+ * @param p is the destination
+ * @param value is the value
+ * @param bytes is the number of bytes to write
+ */
+static inline void put_le(uint8_t *p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+/**
+ * Read a value stored in little-endian order.
+ *
+ * @param p is the source
+ * @param bytes is the number of bytes to read
+ * @return the value
+ */
+static inline uint64_t get_le(const uint8_t *p, int bytes) {
+    uint64_t value = 0;
+
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = value << 8 | p[i];
+    }
+
+    return value;
+}
+
+#endif
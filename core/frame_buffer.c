@@ -0,0 +1,35 @@
+#include <string.h>
+#include "frame_buffer.h"
+
+void frame_buffer_init(frame_buffer_t *buffer) {
+    memset(buffer->frames, 0, sizeof(buffer->frames));
+
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+int frame_buffer_publish(frame_buffer_t *buffer, const uint64_t *video) {
+    memcpy(buffer->frames[buffer->back], video, sizeof(buffer->frames[0]));
+
+    // the exchange releases the frame and acquires the buffer given back by the reader
+    uint32_t middle = atomic_exchange_explicit(&buffer->middle, buffer->back | FRAME_BUFFER_FRESH,
+                                               memory_order_acq_rel);
+
+    buffer->back = middle & ~FRAME_BUFFER_FRESH;
+
+    return (middle & FRAME_BUFFER_FRESH) != 0;
+}
+
+const uint64_t *frame_buffer_acquire(frame_buffer_t *buffer) {
+    if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & FRAME_BUFFER_FRESH)) {
+        return NULL;
+    }
+
+    // only the writer sets the fresh flag: it is still set here
+    uint32_t middle = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+
+    buffer->front = middle & ~FRAME_BUFFER_FRESH;
+
+    return buffer->frames[buffer->front];
+}
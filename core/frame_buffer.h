@@ -0,0 +1,69 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "CHIP-8.h"
+
+/**
+ * Lock-free triple buffer handing complete frames from the thread
+ * running the emulator (the writer) to the thread presenting them
+ * (the reader).
+ *
+ * The writer fills the back buffer and swaps it with the middle one;
+ * the reader swaps the middle buffer with the front one when it holds
+ * a newer frame. Neither thread ever waits for the other: the writer
+ * overwrites the frames that the reader did not pick up in time, and
+ * the reader always gets the newest complete frame.
+ */
+struct frame_buffer_s {
+    uint64_t frames[3][VIDEO_HEIGHT];
+
+    /**
+     * Index of the middle buffer, with FRAME_BUFFER_FRESH set
+     * if it holds a frame that the reader did not acquire yet.
+     */
+    _Atomic uint32_t middle;
+
+    /**
+     * Index of the buffer owned by the writer
+     */
+    uint32_t back;
+
+    /**
+     * Index of the buffer owned by the reader
+     */
+    uint32_t front;
+};
+
+#define FRAME_BUFFER_FRESH 4
+
+typedef struct frame_buffer_s frame_buffer_t;
+
+/**
+ * Initialize the buffers with a blank screen.
+ *
+ * @param buffer is a pointer to the triple buffer
+ */
+extern void frame_buffer_init(frame_buffer_t *buffer);
+
+/**
+ * Publish a frame. Must only be called by the writer.
+ *
+ * @param buffer is a pointer to the triple buffer
+ * @param video is a pointer to the rows of the frame
+ * @return 1 if the previous frame was never acquired, 0 otherwise
+ */
+extern int frame_buffer_publish(frame_buffer_t *buffer, const uint64_t *video);
+
+/**
+ * Acquire the newest frame. Must only be called by the reader.
+ * The frame stays valid until the next call.
+ *
+ * @param buffer is a pointer to the triple buffer
+ * @return a pointer to the rows of the frame, NULL if no frame
+ *         was published since the last call
+ */
+extern const uint64_t *frame_buffer_acquire(frame_buffer_t *buffer);
+
+#endif
@@ -0,0 +1,135 @@
+#include <stddef.h>
+#include "idle_loop.h"
+
+#define OPCODE_AT(chip8, address) \
+    (((chip8)->memory[(address) & 0xFFF] << 8) | (chip8)->memory[((address) + 1) & 0xFFF])
+
+static int skip_timer_wait(CHIP8 *chip8, uint16_t compare);
+
+static int skip_key_wait(CHIP8 *chip8, uint16_t check);
+
+static uint64_t timer_wait_iterations(const CHIP8 *chip8, uint8_t value, int skip_if_equal);
+
+
+int idle_loop_skip(CHIP8 *chip8) {
+    uint16_t pc = chip8->PC;
+    uint16_t first = OPCODE_AT(chip8, pc);
+
+    if ((first & 0xF0FF) == 0xF007) {
+        // Fx07; 3xkk or 4xkk on the same register; 1nnn back to the loop
+        uint16_t compare = OPCODE_AT(chip8, pc + 2);
+        uint16_t jump = OPCODE_AT(chip8, pc + 4);
+
+        if (((compare & 0xF000) == 0x3000 || (compare & 0xF000) == 0x4000)
+            && (compare & 0x0F00) == (first & 0x0F00)
+            && jump == (0x1000 | pc)) {
+            return skip_timer_wait(chip8, compare);
+        }
+    } else if ((first & 0xF0FF) == 0xE09E || (first & 0xF0FF) == 0xE0A1) {
+        // Ex9E or ExA1; 1nnn back to the loop
+        if (OPCODE_AT(chip8, pc + 2) == (0x1000 | pc)) {
+            return skip_key_wait(chip8, first);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Skip the iterations of a timer wait that do not exit the loop.
+ * The delay timer only changes at the end of a cycle, so every
+ * iteration reads the value it has before the iteration, and the
+ * register keeps the value read by the last skipped iteration.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param compare is the opcode of the skip that exits the loop
+ */
+static int skip_timer_wait(CHIP8 *chip8, uint16_t compare) {
+    uint8_t vx = (compare & 0x0F00) >> 8;
+    uint64_t iterations = timer_wait_iterations(chip8, compare & 0x00FF, (compare & 0xF000) == 0x3000);
+
+    if (iterations == 0) {
+        return 0;
+    }
+
+    iterations = iterations < IDLE_LOOP_MAX_ITERATIONS ? iterations : IDLE_LOOP_MAX_ITERATIONS;
+    CHIP8_end_cycles(chip8, 3 * (iterations - 1));
+    chip8->register_file.raw[vx] = chip8->delay_timer;
+    CHIP8_end_cycles(chip8, 3);
+
+    return (int) (3 * iterations);
+}
+
+/**
+ * Count the iterations of a timer wait before the one that exits the loop.
+ * After c cycles the timers were updated (timer_phase + c * TIMER_RATE) / clock_rate
+ * times, as in the scheduler; an iteration takes three cycles.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param value is the value compared with the delay timer
+ * @param skip_if_equal is nonzero if the loop exits when the delay timer equals value
+ * @return the number of iterations, UINT64_MAX if the loop never exits
+ */
+static uint64_t timer_wait_iterations(const CHIP8 *chip8, uint8_t value, int skip_if_equal) {
+    uint8_t delay_timer = chip8->delay_timer;
+    uint64_t updates;
+
+    if ((delay_timer == value) == skip_if_equal) {
+        return 0;
+    }
+
+    if (skip_if_equal) {
+        // the timer counts down to value, unless it is already below
+        if (delay_timer < value) {
+            return UINT64_MAX;
+        }
+
+        updates = delay_timer - value;
+    } else {
+        // the timer leaves value at the next update, unless it stopped
+        if (value == 0) {
+            return UINT64_MAX;
+        }
+
+        updates = 1;
+    }
+
+    uint64_t cycles = updates * chip8->clock_rate - chip8->timer_phase;
+    uint64_t iterations = (cycles + 3 * TIMER_RATE - 1) / (3 * TIMER_RATE);
+
+    // below 3 * TIMER_RATE instructions per second the timer can jump over value
+    uint64_t elapsed = (chip8->timer_phase + 3 * iterations * TIMER_RATE) / chip8->clock_rate;
+    if (skip_if_equal && value != 0 && elapsed > updates) {
+        return UINT64_MAX;
+    }
+
+    return iterations;
+}
+
+/**
+ * Skip the iterations of a key wait until the key changes state.
+ * The keyboard can only change at the end of a cycle, so the loop
+ * is checked again after every iteration.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param check is the opcode of the key check
+ */
+static int skip_key_wait(CHIP8 *chip8, uint16_t check) {
+    uint8_t vx = (check & 0x0F00) >> 8;
+    int skip_if_pressed = (check & 0x00FF) == 0x9E;
+
+    int iterations = 0;
+    while (iterations < IDLE_LOOP_MAX_ITERATIONS
+           && ((chip8->keys >> (chip8->register_file.raw[vx] & 0xF)) & 1) != skip_if_pressed) {
+        // without a keyboard_input function the keys do not change during the skip
+        if (chip8->keyboard_input == NULL) {
+            CHIP8_end_cycles(chip8, 2 * (IDLE_LOOP_MAX_ITERATIONS - iterations));
+            return 2 * IDLE_LOOP_MAX_ITERATIONS;
+        }
+
+        CHIP8_end_cycles(chip8, 2);
+        iterations++;
+    }
+
+    return 2 * iterations;
+}
@@ -0,0 +1,34 @@
+#ifndef IDLE_LOOP_H
+#define IDLE_LOOP_H
+
+#include "CHIP-8.h"
+
+/**
+ * Maximum number of iterations of an idle loop skipped at once,
+ * so that loops that never exit still return control to the caller.
+ */
+#define IDLE_LOOP_MAX_ITERATIONS 256
+
+/**
+ * Fast-forward an idle loop starting at PC.
+ *
+ * Idle loops are tight loops without side effects that only wait for the
+ * delay timer or for the keyboard:
+ *
+ *  - timer waits: Fx07; 3xkk or 4xkk; 1nnn back to the Fx07
+ *  - key waits: Ex9E or ExA1; 1nnn back to the key check
+ *
+ * The iterations that do not exit the loop are not executed: their
+ * outcome is computed from the timer or keyboard state, and only the
+ * end of their cycles (timers and keyboard polling) is emulated with
+ * CHIP8_end_cycles. The number of iterations of a timer wait is computed
+ * from the timer phase; without a keyboard_input function the keys do
+ * not change, so the skipped cycles are completed in one go.
+ * The emulator is left in the same state as if they had been executed.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @return the number of emulated cycles, 0 if PC is not at an idle loop
+ */
+extern int idle_loop_skip(CHIP8 *chip8);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include "input_record.h"
+#include "endian_io.h"
+
+#define HEADER_SIZE 20
+#define ENTRY_SIZE 10
+
+static void apply_entry(CHIP8 *chip8, uint16_t keys);
+
+
+input_record_t *input_record_create(const char *path, CHIP8 *chip8, uint64_t seed) {
+    input_record_t *record = calloc(1, sizeof(input_record_t));
+    uint8_t header[HEADER_SIZE] = {0};
+
+    if (!record || !(record->file = fopen(path, "wb"))) {
+        free(record);
+        return NULL;
+    }
+
+    record->seed = seed;
+    record->clock_rate = chip8->clock_rate;
+
+    memcpy(header, INPUT_RECORD_MAGIC, 4);
+    header[4] = INPUT_RECORD_VERSION;
+    put_le(header + 8, seed, 8);
+    put_le(header + 16, record->clock_rate, 4);
+
+    fwrite(header, 1, HEADER_SIZE, record->file);
+    fflush(record->file);
+
+    CHIP8_set_seed(chip8, seed);
+    CHIP8_set_input_record(chip8, record);
+
+    return record;
+}
+
+input_record_t *input_record_open(const char *path, CHIP8 *chip8) {
+    FILE *file = fopen(path, "rb");
+    uint8_t header[HEADER_SIZE];
+
+    if (!file) {
+        return NULL;
+    }
+
+    input_record_t *record = calloc(1, sizeof(input_record_t));
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (!record || size < HEADER_SIZE || fread(header, 1, HEADER_SIZE, file) != HEADER_SIZE
+        || memcmp(header, INPUT_RECORD_MAGIC, 4) || header[4] != INPUT_RECORD_VERSION
+        || get_le(header + 16, 4) == 0) {
+        fclose(file);
+        free(record);
+        return NULL;
+    }
+
+    record->seed = get_le(header + 8, 8);
+    record->clock_rate = get_le(header + 16, 4);
+
+    // an incomplete last entry is ignored
+    record->count = (size - HEADER_SIZE) / ENTRY_SIZE;
+    // an empty recording still gets a valid (unused) allocation
+    record->entries = calloc(record->count ? record->count : 1, sizeof(input_entry_t));
+
+    for (uint32_t i = 0; record->entries && i < record->count; i++) {
+        uint8_t entry[ENTRY_SIZE];
+
+        if (fread(entry, 1, ENTRY_SIZE, file) != ENTRY_SIZE) {
+            record->count = i;
+            break;
+        }
+
+        record->entries[i].cycle = get_le(entry, 8);
+        record->entries[i].keys = get_le(entry + 8, 2);
+    }
+
+    fclose(file);
+
+    if (!record->entries) {
+        free(record);
+        return NULL;
+    }
+
+    CHIP8_set_seed(chip8, record->seed);
+    CHIP8_set_clock_rate(chip8, record->clock_rate);
+
+    return record;
+}
+
+void input_record_close(input_record_t *record) {
+    if (record->file) {
+        fclose(record->file);
+    }
+
+    free(record->entries);
+    free(record);
+}
+
+void input_record_add(input_record_t *record, uint64_t cycle, uint16_t keys) {
+    uint8_t entry[ENTRY_SIZE];
+
+    put_le(entry, cycle, 8);
+    put_le(entry + 8, keys, 2);
+
+    // the file is complete after every change
+    fwrite(entry, 1, ENTRY_SIZE, record->file);
+    fflush(record->file);
+}
+
+int input_replay_run(input_record_t *record, CHIP8 *chip8, uint64_t cycles) {
+    uint64_t end = chip8->cycle_count + cycles;
+
+    while (1) {
+        // the entries due at the current cycle
+        while (record->next < record->count && record->entries[record->next].cycle <= chip8->cycle_count) {
+            apply_entry(chip8, record->entries[record->next++].keys);
+        }
+
+        uint64_t stop = end;
+        if (record->next < record->count && record->entries[record->next].cycle < stop) {
+            stop = record->entries[record->next].cycle;
+        }
+
+        if (chip8->cycle_count >= end) {
+            break;
+        }
+
+        while (chip8->cycle_count < stop) {
+            if (stop - chip8->cycle_count > CHIP8_MAX_STEP_CYCLES) {
+                CHIP8_step(chip8);
+            } else {
+                CHIP8_tick(chip8);
+            }
+        }
+    }
+
+    return record->next < record->count;
+}
+
+/**
+ * Press and release the keys that differ from the entry.
+ */
+static void apply_entry(CHIP8 *chip8, uint16_t keys) {
+    uint16_t changed = chip8->keys ^ keys;
+
+    for (int key = 0; key < NUM_KEYS; key++) {
+        if (changed & (1 << key)) {
+            CHIP8_key_event(chip8, key, (keys >> key) & 1);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CHIP-8.h"
+
+#define INPUT_RECORD_MAGIC "C8IN"
+#define INPUT_RECORD_VERSION 1
+
+/**
+ * State of the keyboard from a given cycle on
+ */
+struct input_entry_s {
+    uint64_t cycle;
+    uint16_t keys;
+};
+
+typedef struct input_entry_s input_entry_t;
+
+/**
+ * Recording of the keyboard of a session.
+ *
+ * A session starts right after CHIP8_init and the loading of the rom,
+ * and is reproduced bit for bit by a machine with the same seed and
+ * clock rate that receives the same keys at the same cycles.
+ *
+ * File format (little-endian):
+ *  - header: magic (4 bytes), version (1 byte), padding (3 bytes),
+ *    seed (8 bytes), clock rate (4 bytes)
+ *  - entries until the end of the file: cycle (8 bytes), keys (2 bytes)
+ *
+ * A recording appends its entries to the file as they happen, so the
+ * file is complete even if the session is not closed. A replay loads
+ * the whole file.
+ */
+struct input_record_s {
+    uint64_t seed;
+    uint32_t clock_rate;
+
+    // recording: file receiving the entries
+    FILE *file;
+
+    // replay: entries, and index of the next entry to apply
+    input_entry_t *entries;
+    uint32_t count;
+    uint32_t next;
+};
+
+typedef struct input_record_s input_record_t;
+
+/**
+ * Start recording a session: the seed of the machine is set and the
+ * keyboard changes are written to the file from now on.
+ *
+ * @param path is the path of the recording
+ * @param chip8 is a pointer to the emulator, just initialized
+ * @param seed is the seed of the random number generator
+ * @return the recording, or NULL if the file cannot be written
+ */
+extern input_record_t *input_record_create(const char *path, CHIP8 *chip8, uint64_t seed);
+
+/**
+ * Load a recording and prepare the machine to replay it: the seed and
+ * the clock rate of the session are set.
+ *
+ * @param path is the path of the recording
+ * @param chip8 is a pointer to the emulator, just initialized
+ * @return the recording, or NULL if the file is not a valid recording
+ */
+extern input_record_t *input_record_open(const char *path, CHIP8 *chip8);
+
+/**
+ * Stop a recording or a replay and free it.
+ *
+ * @param record is a pointer to the recording
+ */
+extern void input_record_close(input_record_t *record);
+
+/**
+ * Append an entry to a recording. Called by the emulator.
+ *
+ * @param record is a pointer to the recording
+ * @param cycle is the number of cycles emulated before the change
+ * @param keys is the new keyboard state
+ */
+extern void input_record_add(input_record_t *record, uint64_t cycle, uint16_t keys);
+
+/**
+ * Run the emulator for a number of cycles, pressing and releasing the
+ * keys at the cycles they were recorded at.
+ *
+ * The engine runs whole steps while they cannot go past the next entry;
+ * the last cycles before an entry are executed one at a time, so that
+ * the replay does not depend on the engine.
+ *
+ * @param record is a pointer to the recording
+ * @param chip8 is a pointer to the emulator
+ * @param cycles is the number of cycles to run
+ * @return 1 if entries remain to be replayed, 0 if the replay is over
+ */
+extern int input_replay_run(input_record_t *record, CHIP8 *chip8, uint64_t cycles);
+
+#endif
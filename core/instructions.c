@@ -6,7 +6,15 @@
 void sys(CHIP8 *chip8, uint16_t opcode) {}
 
 void clear_screen(CHIP8 *chip8, uint16_t opcode) {
-    memset(chip8->video, 0, VIDEO_SIZE);
+    // only the lit pixels change
+    for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        if (chip8->video[y]) {
+            chip8->damage[y] |= chip8->video[y];
+            chip8->dirty_rows |= 1u << y;
+        }
+    }
+
+    memset(chip8->video, 0, sizeof(chip8->video));
 }
 
 void ret(CHIP8 *chip8, uint16_t opcode) {
@@ -149,36 +157,57 @@ void jump_addr(CHIP8 *chip8, uint16_t opcode) {
 void rnd(CHIP8 *chip8, uint16_t opcode) {
     uint8_t vx = (opcode & 0x0F00) >> 8;
 
-    chip8->register_file.raw[vx] = (rand() % 255) & (opcode & 0x00FF);
+    uint64_t x = chip8->random_state;
+
+    // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    chip8->random_state = x;
+
+    chip8->register_file.raw[vx] = (uint8_t) (x >> 56) & (opcode & 0x00FF);
 }
 
 void draw(CHIP8 *chip8, uint16_t opcode) {
     uint8_t bx = chip8->register_file.raw[(opcode & 0x0F00) >> 8];
     uint8_t by = chip8->register_file.raw[(opcode & 0x00F0) >> 4];
     uint8_t height = opcode & 0x000F;
+    uint64_t collision = 0;
 
-    chip8->register_file.VF = 0;
     for (uint8_t yi = 0; yi < height; yi++) {
-        uint8_t p = chip8->memory[chip8->I + yi];
-
-        for (uint8_t xi = 0; xi < 8; xi++) {
-            if (p & (0x80 >> xi)) {
-                //uint16_t pos = (((bx + xi) % 64) + (((by + yi) % 32) * 64));
-                uint16_t pos = ((bx + xi) + ((by + yi) * 64)) % (64 * 32);
-                uint8_t prev = chip8->video[pos];
-                chip8->video[pos] ^= 1;
-                chip8->register_file.VF |= (prev && !chip8->video[pos]);
-            }
+        uint64_t p = chip8->memory[chip8->I + yi];
+
+        // position of the first pixel of the row, pixels past the
+        // right border continue on the next row
+        uint16_t pos = (bx + ((by + yi) * 64)) % (64 * 32);
+        uint8_t row = pos / 64;
+        uint8_t x = pos % 64;
+
+        uint64_t sprite = p << 56 >> x;
+        collision |= chip8->video[row] & sprite;
+        chip8->video[row] ^= sprite;
+        chip8->damage[row] |= sprite;
+        chip8->dirty_rows |= (uint32_t) (sprite != 0) << row;
+
+        if (x > 56) {
+            row = (row + 1) % 32;
+            sprite = p << (120 - x);
+            collision |= chip8->video[row] & sprite;
+            chip8->video[row] ^= sprite;
+            chip8->damage[row] |= sprite;
+            chip8->dirty_rows |= (uint32_t) (sprite != 0) << row;
         }
     }
 
+    chip8->register_file.VF = collision != 0;
+
     chip8->draw_flag = 1;
 }
 
 void skip_if_pressed(CHIP8 *chip8, uint16_t opcode) {
     uint8_t vx = (opcode & 0x0F00) >> 8;
 
-    if (chip8->key[chip8->register_file.raw[vx]]) {
+    if (chip8->keys & (1 << (chip8->register_file.raw[vx] & 0xF))) {
         chip8->PC = chip8->PC + 2;
     }
 }
@@ -186,7 +215,7 @@ void skip_if_pressed(CHIP8 *chip8, uint16_t opcode) {
 void skip_if_not_pressed(CHIP8 *chip8, uint16_t opcode) {
     uint8_t vx = (opcode & 0x0F00) >> 8;
 
-    if (!chip8->key[chip8->register_file.raw[vx]]) {
+    if (!(chip8->keys & (1 << (chip8->register_file.raw[vx] & 0xF)))) {
         chip8->PC = chip8->PC + 2;
     }
 }
@@ -199,18 +228,17 @@ void load_timer_value(CHIP8 *chip8, uint16_t opcode) {
 
 void load_key(CHIP8 *chip8, uint16_t opcode) {
     uint8_t vx = (opcode & 0x0F00) >> 8;
-    int pressed = 0;
 
-    for (int i = 0; i < NUM_KEYS; i++) {
-        if (chip8->key[i]) {
-            chip8->register_file.raw[vx] = chip8->key[i];
-            pressed++;
-        }
+    if (chip8->keys) {
+        chip8->register_file.raw[vx] = __builtin_ctz(chip8->keys);
+        return;
     }
 
-    if (!pressed) {
-        chip8->PC = chip8->PC - 2;
-    }
+    // block the CPU on this instruction until a key is pressed
+    chip8->key_presses = 0;
+    chip8->waiting_key = 1;
+    chip8->key_register = vx;
+    chip8->PC = chip8->PC - 2;
 }
 
 void set_timer_value(CHIP8 *chip8, uint16_t opcode) {
@@ -244,12 +272,16 @@ void load_bcd_representation(CHIP8 *chip8, uint16_t opcode) {
     chip8->memory[chip8->I + 0] = value / 100;
     chip8->memory[chip8->I + 1] = (value % 100) / 10;
     chip8->memory[chip8->I + 2] = value % 10;
+
+    CHIP8_memory_written(chip8, chip8->I, 3);
 }
 
 void store_registers(CHIP8 *chip8, uint16_t opcode) {
     uint8_t vx = (opcode & 0x0F00) >> 8;
 
     memcpy(&chip8->memory[chip8->I], &chip8->register_file.raw, vx + 1);
+
+    CHIP8_memory_written(chip8, chip8->I, vx + 1);
 }
 
 void load_registers(CHIP8 *chip8, uint16_t opcode) {
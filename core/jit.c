@@ -0,0 +1,730 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jit.h"
+#include "instructions.h"
+
+#if JIT_AVAILABLE
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * x86-64 general purpose registers
+ */
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+#define REG_NONE (-1)
+
+/**
+ * Host register that holds the pointer to the emulator.
+ * It is callee-saved, so it survives the calls to the handlers.
+ */
+#define REG_CHIP8 RBX
+
+/**
+ * Host register that holds the index register I
+ */
+#define REG_I R12
+
+/**
+ * Host registers available to the registers of the CHIP8.
+ * They are written back to the emulator before every call,
+ * so caller-saved registers can be used as well.
+ */
+static const int allocatable[] = {R8, R9, R10, R11, R13, R14, R15, RBP};
+
+#define NUM_ALLOCATABLE (sizeof(allocatable) / sizeof(allocatable[0]))
+
+/**
+ * Upper bounds of the size of the code emitted for the prologue and
+ * the epilogue of a block, and for a single instruction.
+ */
+#define MAX_FRAME_SIZE 256
+#define MAX_OP_SIZE 256
+
+// condition codes
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_A 0x7
+
+// group 1 opcode extensions
+#define ALU_ADD 0
+#define ALU_AND 4
+#define ALU_CMP 7
+
+// group 2 opcode extensions
+#define SHIFT_LEFT 4
+#define SHIFT_RIGHT 5
+
+#define OFFSET_V(x) ((int32_t) (offsetof(CHIP8, register_file) + (x)))
+#define OFFSET_I ((int32_t) offsetof(CHIP8, I))
+#define OFFSET_PC ((int32_t) offsetof(CHIP8, PC))
+#define OFFSET_SP ((int32_t) offsetof(CHIP8, SP))
+#define OFFSET_STACK ((int32_t) offsetof(CHIP8, stack))
+
+/**
+ * State of the translation of a block
+ */
+struct emitter_s {
+    uint8_t *p;
+
+    // host register assigned to each register of the CHIP8, or REG_NONE
+    int host[16];
+
+    // instructions executed since the timers were last updated
+    int pending;
+
+    // nonzero once the translation has written the final PC
+    int pc_written;
+};
+
+typedef struct emitter_s emitter_t;
+
+static void jit_retire(CHIP8 *chip8, int cycles);
+
+static void jit_execute(CHIP8 *chip8, uint16_t opcode, instruction_runner execute);
+
+static void allocate_registers(emitter_t *em, const block_t *block);
+
+static int translate(emitter_t *em, const decoded_op_t *op, uint16_t address);
+
+static void flush_all(jit_t *jit, block_cache_t *cache);
+
+static int protect(jit_t *jit, uint32_t start, uint32_t length, int writable);
+
+
+jit_t *jit_create() {
+    jit_t *jit = malloc(sizeof(jit_t));
+    if (!jit) {
+        return NULL;
+    }
+
+    // the pages are only made executable once the translations are written
+    void *code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+
+    jit->code = code;
+    jit->size = JIT_CODE_SIZE;
+    jit->used = 0;
+
+    return jit;
+}
+
+void jit_destroy(jit_t *jit) {
+    munmap(jit->code, jit->size);
+    free(jit);
+}
+
+/*
+ * Instruction encoding
+ */
+
+static void emit8(emitter_t *em, uint8_t value) {
+    *em->p++ = value;
+}
+
+static void emit16(emitter_t *em, uint16_t value) {
+    memcpy(em->p, &value, sizeof(value));
+    em->p += sizeof(value);
+}
+
+static void emit32(emitter_t *em, uint32_t value) {
+    memcpy(em->p, &value, sizeof(value));
+    em->p += sizeof(value);
+}
+
+static void emit64(emitter_t *em, uint64_t value) {
+    memcpy(em->p, &value, sizeof(value));
+    em->p += sizeof(value);
+}
+
+/**
+ * Emit a REX prefix if it is needed to address the given registers.
+ * force is used by byte operations, which need the prefix to address
+ * SPL, BPL, SIL and DIL instead of AH, CH, DH and BH.
+ */
+static void emit_rex(emitter_t *em, int w, int reg, int rm, int force) {
+    uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+
+    if (rex != 0x40 || force) {
+        emit8(em, rex);
+    }
+}
+
+/**
+ * Emit an instruction with a [REG_CHIP8 + disp32] memory operand.
+ */
+static void emit_mem(emitter_t *em, int operand16, int force_rex,
+                     uint8_t op0, uint8_t op1, int reg, int32_t disp) {
+    if (operand16) {
+        emit8(em, 0x66);
+    }
+
+    emit_rex(em, 0, reg, REG_CHIP8, force_rex);
+    emit8(em, op0);
+    if (op0 == 0x0F) {
+        emit8(em, op1);
+    }
+
+    emit8(em, 0x80 | ((reg & 7) << 3) | (REG_CHIP8 & 7));
+    emit32(em, (uint32_t) disp);
+}
+
+/**
+ * Emit "op dst, src" for the one-byte ALU and MOV opcodes (r/m, reg form).
+ */
+static void emit_rr(emitter_t *em, uint8_t op, int dst, int src) {
+    emit_rex(em, 0, src, dst, 0);
+    emit8(em, op);
+    emit8(em, 0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+/**
+ * Emit "op dst, src" for the two-byte opcodes (reg, r/m form).
+ */
+static void emit_rr_0f(emitter_t *em, uint8_t op, int dst, int src, int force_rex) {
+    emit_rex(em, 0, dst, src, force_rex);
+    emit8(em, 0x0F);
+    emit8(em, op);
+    emit8(em, 0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+static void emit_mov_imm(emitter_t *em, int reg, uint32_t value) {
+    emit_rex(em, 0, 0, reg, 0);
+    emit8(em, 0xB8 + (reg & 7));
+    emit32(em, value);
+}
+
+static void emit_alu_imm(emitter_t *em, int ext, int reg, uint32_t value) {
+    emit_rex(em, 0, 0, reg, 0);
+    emit8(em, 0x81);
+    emit8(em, 0xC0 | (ext << 3) | (reg & 7));
+    emit32(em, value);
+}
+
+static void emit_shift(emitter_t *em, int ext, int reg, uint8_t amount) {
+    emit_rex(em, 0, 0, reg, 0);
+    emit8(em, 0xC1);
+    emit8(em, 0xC0 | (ext << 3) | (reg & 7));
+    emit8(em, amount);
+}
+
+/**
+ * Truncate a register to its low byte
+ */
+static void emit_truncate(emitter_t *em, int reg) {
+    emit_rr_0f(em, 0xB6, reg, reg, 1);
+}
+
+/**
+ * Set reg to 1 if the condition holds, 0 otherwise
+ */
+static void emit_setcc(emitter_t *em, int cc, int reg) {
+    emit_rex(em, 0, 0, reg, 1);
+    emit8(em, 0x0F);
+    emit8(em, 0x90 | cc);
+    emit8(em, 0xC0 | (reg & 7));
+    emit_truncate(em, reg);
+}
+
+static void emit_push(emitter_t *em, int reg) {
+    emit_rex(em, 0, 0, reg, 0);
+    emit8(em, 0x50 + (reg & 7));
+}
+
+static void emit_pop(emitter_t *em, int reg) {
+    emit_rex(em, 0, 0, reg, 0);
+    emit8(em, 0x58 + (reg & 7));
+}
+
+static void emit_call(emitter_t *em, void *function) {
+    // mov rax, function; call rax
+    emit8(em, 0x48);
+    emit8(em, 0xB8);
+    emit64(em, (uint64_t) (uintptr_t) function);
+    emit8(em, 0xFF);
+    emit8(em, 0xD0);
+}
+
+static void emit_store_pc(emitter_t *em, uint16_t value) {
+    emit_mem(em, 1, 0, 0xC7, 0, 0, OFFSET_PC);
+    emit16(em, value);
+}
+
+/*
+ * Access to the CHIP8 registers
+ */
+
+/**
+ * Return a host register holding the value of Vx:
+ * its assigned register, or scratch after loading Vx into it.
+ */
+static int read_v(emitter_t *em, int x, int scratch) {
+    if (em->host[x] != REG_NONE) {
+        return em->host[x];
+    }
+
+    emit_mem(em, 0, 0, 0x0F, 0xB6, scratch, OFFSET_V(x));
+    return scratch;
+}
+
+/**
+ * Copy a value lower than 256 from a host register to Vx
+ */
+static void write_v(emitter_t *em, int x, int src) {
+    if (em->host[x] == REG_NONE) {
+        emit_mem(em, 0, 1, 0x88, 0, src, OFFSET_V(x));
+    } else if (em->host[x] != src) {
+        emit_rr(em, 0x89, em->host[x], src);
+    }
+}
+
+/**
+ * Write the registers held by the host back to the emulator
+ */
+static void spill(emitter_t *em) {
+    for (int x = 0; x < 16; x++) {
+        if (em->host[x] != REG_NONE) {
+            emit_mem(em, 0, 1, 0x88, 0, em->host[x], OFFSET_V(x));
+        }
+    }
+
+    emit_mem(em, 1, 0, 0x89, 0, REG_I, OFFSET_I);
+}
+
+/**
+ * Load the registers held by the host from the emulator
+ */
+static void reload(emitter_t *em) {
+    for (int x = 0; x < 16; x++) {
+        if (em->host[x] != REG_NONE) {
+            emit_mem(em, 0, 0, 0x0F, 0xB6, em->host[x], OFFSET_V(x));
+        }
+    }
+
+    emit_mem(em, 0, 0, 0x0F, 0xB7, REG_I, OFFSET_I);
+}
+
+/**
+ * Update the timers and the keyboard for the instructions
+ * executed since the last update. Must be called with the
+ * registers spilled.
+ */
+static void emit_retire(emitter_t *em) {
+    if (!em->pending) {
+        return;
+    }
+
+    // mov rdi, rbx; mov esi, pending
+    emit8(em, 0x48);
+    emit8(em, 0x89);
+    emit8(em, 0xDF);
+    emit_mov_imm(em, RSI, em->pending);
+    emit_call(em, (void *) &jit_retire);
+
+    em->pending = 0;
+}
+
+/**
+ * Emit a call to the handler of an instruction.
+ *
+ * @param em is the emitter
+ * @param op is the instruction
+ * @param address is the address of the instruction
+ * @param observes is nonzero if the instruction reads or writes the
+ *        timers, the keyboard or the screen: the pending cycles are
+ *        retired before it runs, and the cycle it takes is completed
+ *        right after it as CHIP8_tick does
+ */
+static void emit_handler_call(emitter_t *em, const decoded_op_t *op, uint16_t address, int observes) {
+    spill(em);
+
+    if (observes) {
+        emit_retire(em);
+    }
+
+    emit_store_pc(em, address + 2);
+
+    // mov rdi, rbx; mov esi, opcode
+    emit8(em, 0x48);
+    emit8(em, 0x89);
+    emit8(em, 0xDF);
+    emit_mov_imm(em, RSI, op->opcode);
+
+    if (observes) {
+        // mov rdx, execute
+        emit8(em, 0x48);
+        emit8(em, 0xBA);
+        emit64(em, (uint64_t) (uintptr_t) op->execute);
+        emit_call(em, (void *) &jit_execute);
+    } else {
+        emit_call(em, (void *) op->execute);
+        em->pending++;
+    }
+
+    reload(em);
+}
+
+/**
+ * Emit a conditional skip: PC is set to address + 4 if the flags
+ * satisfy the condition, to address + 2 otherwise.
+ */
+static void emit_skip(emitter_t *em, int cc, uint16_t address) {
+    emit_mov_imm(em, RDX, address + 2);
+    emit_mov_imm(em, RSI, address + 4);
+    emit_rr_0f(em, 0x40 | cc, RDX, RSI, 0);
+    emit_mem(em, 1, 0, 0x89, 0, RDX, OFFSET_PC);
+
+    em->pc_written = 1;
+}
+
+void jit_compile(jit_t *jit, block_cache_t *cache, block_t *block) {
+    uint32_t needed = MAX_FRAME_SIZE + block->length * MAX_OP_SIZE;
+
+    if (jit->size - jit->used < needed) {
+        flush_all(jit, cache);
+    }
+
+    // the block keeps running from the cache if the pages cannot be written;
+    // the earlier translations may share a page that is no longer executable
+    uint32_t start = jit->used;
+    if (!protect(jit, start, needed, 1)) {
+        flush_all(jit, cache);
+        return;
+    }
+
+    emitter_t em;
+    em.p = jit->code + jit->used;
+    em.pending = 0;
+    em.pc_written = 0;
+
+    allocate_registers(&em, block);
+
+    // prologue: save the callee-saved registers and keep the stack aligned
+    uint8_t *entry = em.p;
+    emit_push(&em, RBX);
+    emit_push(&em, RBP);
+    emit_push(&em, R12);
+    emit_push(&em, R13);
+    emit_push(&em, R14);
+    emit_push(&em, R15);
+    emit8(&em, 0x48);
+    emit8(&em, 0x83);
+    emit8(&em, 0xEC);
+    emit8(&em, 0x08);
+
+    // mov rbx, rdi
+    emit8(&em, 0x48);
+    emit8(&em, 0x89);
+    emit8(&em, 0xFB);
+
+    reload(&em);
+
+    uint16_t address = block->start;
+    for (int i = 0; i < block->length; i++, address += 2) {
+        const decoded_op_t *op = &block->ops[i];
+
+        // only the last instruction of the block decides the final PC
+        em.pc_written = 0;
+
+        if (translate(&em, op, address)) {
+            em.pending++;
+        } else if (op->execute == &clear_screen
+                   || op->execute == &rnd
+                   || op->execute == &load_registers) {
+            emit_handler_call(&em, op, address, 0);
+            em.pc_written = 1;
+        } else {
+            emit_handler_call(&em, op, address, 1);
+            em.pc_written = 1;
+        }
+    }
+
+    // epilogue
+    spill(&em);
+    emit_retire(&em);
+
+    if (!em.pc_written) {
+        emit_store_pc(&em, block->end);
+    }
+
+    emit8(&em, 0x48);
+    emit8(&em, 0x83);
+    emit8(&em, 0xC4);
+    emit8(&em, 0x08);
+    emit_pop(&em, R15);
+    emit_pop(&em, R14);
+    emit_pop(&em, R13);
+    emit_pop(&em, R12);
+    emit_pop(&em, RBP);
+    emit_pop(&em, RBX);
+    emit8(&em, 0xC3);
+
+    jit->used = em.p - jit->code;
+
+    // the pages stay writable: the translations on them cannot run
+    if (!protect(jit, start, needed, 0)) {
+        flush_all(jit, cache);
+        return;
+    }
+
+    block->native = (void (*)(CHIP8 *)) entry;
+}
+
+/**
+ * Emit native code for an instruction that only works on
+ * registers, the stack and the program counter.
+ *
+ * @return nonzero if the instruction was translated, zero if
+ *         its handler must be called instead
+ */
+static int translate(emitter_t *em, const decoded_op_t *op, uint16_t address) {
+    instruction_runner execute = op->execute;
+    int x = op->x, y = op->y;
+    int a, b;
+
+    if (execute == NULL || execute == &sys) {
+        // nothing to do
+    } else if (execute == &load_immediate) {
+        if (em->host[x] != REG_NONE) {
+            emit_mov_imm(em, em->host[x], op->kk);
+        } else {
+            emit_mem(em, 0, 0, 0xC6, 0, 0, OFFSET_V(x));
+            emit8(em, op->kk);
+        }
+    } else if (execute == &add_immediate) {
+        a = read_v(em, x, RAX);
+        emit_alu_imm(em, ALU_ADD, a, op->kk);
+        emit_truncate(em, a);
+        write_v(em, x, a);
+    } else if (execute == &mov) {
+        write_v(em, x, read_v(em, y, RCX));
+    } else if (execute == &or || execute == &and || execute == &xor) {
+        a = read_v(em, x, RAX);
+        b = read_v(em, y, RCX);
+        emit_rr(em, execute == &or ? 0x09 : execute == &and ? 0x21 : 0x31, a, b);
+        write_v(em, x, a);
+    } else if (execute == &add_reg) {
+        a = read_v(em, x, RAX);
+        b = read_v(em, y, RCX);
+        emit_rr(em, 0x89, RDX, a);
+        emit_rr(em, 0x01, RDX, b);
+        emit_rr(em, 0x89, RSI, RDX);
+        emit_truncate(em, RSI);
+        write_v(em, x, RSI);
+        emit_shift(em, SHIFT_RIGHT, RDX, 8);
+        write_v(em, 0xF, RDX);
+    } else if (execute == &sub || execute == &subn) {
+        // sub: Vx = Vx - Vy, subn: Vx = Vy - Vx
+        a = read_v(em, execute == &sub ? x : y, RAX);
+        b = read_v(em, execute == &sub ? y : x, RCX);
+        emit_rr(em, 0x89, RDX, a);
+        emit_rr(em, 0x29, RDX, b);
+        emit_truncate(em, RDX);
+        emit_rr(em, 0x39, a, b);
+        emit_setcc(em, CC_A, RSI);
+        write_v(em, x, RDX);
+        write_v(em, 0xF, RSI);
+    } else if (execute == &shift_right || execute == &shift_left) {
+        // VF is written first, then Vx is read again as the handlers do
+        a = read_v(em, x, RAX);
+        emit_rr(em, 0x89, RDX, a);
+        if (execute == &shift_right) {
+            emit_alu_imm(em, ALU_AND, RDX, 0x01);
+        } else {
+            emit_shift(em, SHIFT_RIGHT, RDX, 7);
+        }
+        write_v(em, 0xF, RDX);
+
+        a = read_v(em, x, RAX);
+        emit_rr(em, 0x89, RDX, a);
+        emit_shift(em, execute == &shift_right ? SHIFT_RIGHT : SHIFT_LEFT, RDX, 1);
+        emit_truncate(em, RDX);
+        write_v(em, x, RDX);
+    } else if (execute == &skip_equal_imm || execute == &skip_not_equal_imm) {
+        a = read_v(em, x, RAX);
+        emit_alu_imm(em, ALU_CMP, a, op->kk);
+        emit_skip(em, execute == &skip_equal_imm ? CC_E : CC_NE, address);
+    } else if (execute == &skip_equal_reg || execute == &skip_ne_reg) {
+        a = read_v(em, x, RAX);
+        b = read_v(em, y, RCX);
+        emit_rr(em, 0x39, a, b);
+        emit_skip(em, execute == &skip_equal_reg ? CC_E : CC_NE, address);
+    } else if (execute == &jump_immediate) {
+        emit_store_pc(em, op->nnn);
+        em->pc_written = 1;
+    } else if (execute == &jump_addr) {
+        a = read_v(em, 0, RAX);
+        emit_rr(em, 0x89, RDX, a);
+        emit_alu_imm(em, ALU_ADD, RDX, op->nnn);
+        emit_mem(em, 1, 0, 0x89, 0, RDX, OFFSET_PC);
+        em->pc_written = 1;
+    } else if (execute == &call) {
+        // movzx eax, byte [SP]; mov word [rbx + rax * 2 + stack], address + 2
+        emit_mem(em, 0, 0, 0x0F, 0xB6, RAX, OFFSET_SP);
+        emit8(em, 0x66);
+        emit8(em, 0xC7);
+        emit8(em, 0x84);
+        emit8(em, 0x43);
+        emit32(em, (uint32_t) OFFSET_STACK);
+        emit16(em, address + 2);
+
+        // inc byte [SP]
+        emit_mem(em, 0, 0, 0xFE, 0, 0, OFFSET_SP);
+
+        emit_store_pc(em, op->nnn);
+        em->pc_written = 1;
+    } else if (execute == &ret) {
+        // dec byte [SP]; movzx eax, byte [SP]
+        emit_mem(em, 0, 0, 0xFE, 0, 1, OFFSET_SP);
+        emit_mem(em, 0, 0, 0x0F, 0xB6, RAX, OFFSET_SP);
+
+        // movzx ecx, word [rbx + rax * 2 + stack]
+        emit8(em, 0x0F);
+        emit8(em, 0xB7);
+        emit8(em, 0x8C);
+        emit8(em, 0x43);
+        emit32(em, (uint32_t) OFFSET_STACK);
+
+        emit_mem(em, 1, 0, 0x89, 0, RCX, OFFSET_PC);
+        em->pc_written = 1;
+    } else if (execute == &load_index) {
+        emit_mov_imm(em, REG_I, op->nnn);
+    } else if (execute == &add_to_index) {
+        a = read_v(em, x, RAX);
+        emit_rr(em, 0x01, REG_I, a);
+        emit_rr_0f(em, 0xB7, REG_I, REG_I, 0);
+    } else if (execute == &load_sprite_location) {
+        a = read_v(em, x, RAX);
+        emit_rr(em, 0x89, REG_I, a);
+        emit_shift(em, SHIFT_LEFT, REG_I, 2);
+        emit_rr(em, 0x01, REG_I, a);
+        emit_alu_imm(em, ALU_ADD, REG_I, MEMORY_FONTSET_START);
+    } else {
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Assign host registers to the CHIP8 registers that the translated
+ * instructions of the block use most often.
+ */
+static void allocate_registers(emitter_t *em, const block_t *block) {
+    int uses[16] = {0};
+
+    for (int i = 0; i < block->length; i++) {
+        const decoded_op_t *op = &block->ops[i];
+        instruction_runner execute = op->execute;
+
+        if (execute == &load_immediate || execute == &add_immediate
+            || execute == &skip_equal_imm || execute == &skip_not_equal_imm
+            || execute == &add_to_index || execute == &load_sprite_location) {
+            uses[op->x]++;
+        } else if (execute == &mov || execute == &or || execute == &and || execute == &xor
+                   || execute == &skip_equal_reg || execute == &skip_ne_reg) {
+            uses[op->x]++;
+            uses[op->y]++;
+        } else if (execute == &add_reg || execute == &sub || execute == &subn) {
+            uses[op->x]++;
+            uses[op->y]++;
+            uses[0xF]++;
+        } else if (execute == &shift_right || execute == &shift_left) {
+            uses[op->x]++;
+            uses[0xF]++;
+        } else if (execute == &jump_addr) {
+            uses[0]++;
+        }
+    }
+
+    for (int x = 0; x < 16; x++) {
+        em->host[x] = REG_NONE;
+    }
+
+    // a register used once is cheaper to access in memory
+    for (unsigned r = 0; r < NUM_ALLOCATABLE; r++) {
+        int best = -1;
+
+        for (int x = 0; x < 16; x++) {
+            if (em->host[x] == REG_NONE && uses[x] >= 2 && (best < 0 || uses[x] > uses[best])) {
+                best = x;
+            }
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        em->host[best] = allocatable[r];
+    }
+}
+
+/**
+ * Discard every translation and reuse the executable memory.
+ */
+static void flush_all(jit_t *jit, block_cache_t *cache) {
+    for (int i = 0; i < MEMORY_SIZE; i++) {
+        if (cache->blocks[i] != NULL) {
+            cache->blocks[i]->native = NULL;
+        }
+    }
+
+    jit->used = 0;
+}
+
+/**
+ * Switch the pages of a range of the code region between writable and
+ * executable, so that no page is both at the same time.
+ *
+ * @return nonzero on success
+ */
+static int protect(jit_t *jit, uint32_t start, uint32_t length, int writable) {
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t) (jit->code + start) & ~(page - 1);
+    uintptr_t last = (uintptr_t) (jit->code + start + length + page - 1) & ~(page - 1);
+
+    return mprotect((void *) first, last - first, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+}
+
+/**
+ * Complete the given number of cycles of instructions that did not
+ * interact with the timers, the keyboard or the screen.
+ */
+static void jit_retire(CHIP8 *chip8, int cycles) {
+    chip8->draw_flag = 0;
+
+    for (int i = 0; i < cycles; i++) {
+        CHIP8_end_cycle(chip8);
+    }
+}
+
+/**
+ * Execute one instruction through its handler as CHIP8_tick does.
+ */
+static void jit_execute(CHIP8 *chip8, uint16_t opcode, instruction_runner execute) {
+    chip8->draw_flag = 0;
+    execute(chip8, opcode);
+    CHIP8_end_cycle(chip8);
+}
+
+#else
+
+jit_t *jit_create() {
+    return NULL;
+}
+
+void jit_destroy(jit_t *jit) {}
+
+void jit_compile(jit_t *jit, block_cache_t *cache, block_t *block) {}
+
+#endif
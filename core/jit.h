@@ -0,0 +1,73 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include "CHIP-8.h"
+#include "block_cache.h"
+
+/**
+ * The JIT is only available on x86-64 hosts that can map executable memory.
+ * On the other hosts jit_create always fails and the emulator
+ * keeps running blocks from the block cache.
+ */
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define JIT_AVAILABLE 1
+#else
+#define JIT_AVAILABLE 0
+#endif
+
+/**
+ * Number of executions after which a block is translated to native code
+ */
+#define JIT_THRESHOLD 16
+
+/**
+ * Size of the executable memory region that holds the translations
+ */
+#define JIT_CODE_SIZE (1024 * 1024)
+
+/**
+ * Executable memory region used as a bump allocator for translations.
+ * When the region is full every translation is discarded
+ * and the region is reused from the beginning. A page is never writable
+ * and executable at once: the pages of a translation are made writable
+ * while it is emitted, then executable.
+ */
+struct jit_s {
+    uint8_t *code;
+    uint32_t size;
+    uint32_t used;
+};
+
+typedef struct jit_s jit_t;
+
+/**
+ * Allocate the executable memory used by the JIT.
+ *
+ * @return the JIT, or NULL if the host does not support it
+ */
+extern jit_t *jit_create();
+
+/**
+ * Release the executable memory used by the JIT.
+ *
+ * @param jit is a pointer to the JIT
+ */
+extern void jit_destroy(jit_t *jit);
+
+/**
+ * Translate a block to x86-64 code and store the result in block->native.
+ *
+ * The translation keeps the registers used by the block, I and PC
+ * in host registers, and calls the instructions.c handlers for the
+ * instructions that interact with the screen, the keyboard, the timers
+ * or the random number generator. After it runs, the emulator is in
+ * the same state as after running the block with CHIP8_tick.
+ *
+ * @param jit is a pointer to the JIT
+ * @param cache is the cache that owns the block
+ * @param block is the block to translate
+ */
+extern void jit_compile(jit_t *jit, block_cache_t *cache, block_t *block);
+
+#endif
@@ -0,0 +1,38 @@
+#include "key_queue.h"
+
+void key_queue_init(key_queue_t *queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+}
+
+int key_queue_push(key_queue_t *queue, key_event_t event) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head - tail == KEY_QUEUE_SIZE) {
+        return 0;
+    }
+
+    queue->events[head % KEY_QUEUE_SIZE] = event;
+
+    // publish the event after writing it
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    return 1;
+}
+
+int key_queue_drain(key_queue_t *queue, CHIP8 *chip8) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    for (uint32_t i = tail; i != head; i++) {
+        key_event_t event = queue->events[i % KEY_QUEUE_SIZE];
+
+        CHIP8_key_event(chip8, event.key, event.pressed);
+    }
+
+    // release the slots after reading them
+    atomic_store_explicit(&queue->tail, head, memory_order_release);
+
+    return (int) (head - tail);
+}
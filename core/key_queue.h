@@ -0,0 +1,65 @@
+#ifndef KEY_QUEUE_H
+#define KEY_QUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "CHIP-8.h"
+
+/**
+ * Number of events the queue can hold, must be a power of two
+ */
+#define KEY_QUEUE_SIZE 64
+
+/**
+ * A key going down or up
+ */
+struct key_event_s {
+    uint8_t key;
+    uint8_t pressed;
+};
+
+typedef struct key_event_s key_event_t;
+
+/**
+ * Lock-free queue of key events between one producer thread
+ * (the frontend reading the keyboard) and one consumer thread
+ * (the thread running the emulator).
+ *
+ * head and tail count the events pushed and popped since the
+ * creation of the queue: each index is only written by its owner.
+ */
+struct key_queue_s {
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    key_event_t events[KEY_QUEUE_SIZE];
+};
+
+typedef struct key_queue_s key_queue_t;
+
+/**
+ * Initialize an empty queue.
+ *
+ * @param queue is a pointer to the queue
+ */
+extern void key_queue_init(key_queue_t *queue);
+
+/**
+ * Add an event to the queue. Must only be called by the producer.
+ *
+ * @param queue is a pointer to the queue
+ * @param event is the event to add
+ * @return 1 on success, 0 if the queue is full
+ */
+extern int key_queue_push(key_queue_t *queue, key_event_t event);
+
+/**
+ * Pass every queued event to the emulator with CHIP8_key_event.
+ * Must only be called by the consumer.
+ *
+ * @param queue is a pointer to the queue
+ * @param chip8 is a pointer to the emulator
+ * @return the number of events
+ */
+extern int key_queue_drain(key_queue_t *queue, CHIP8 *chip8);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include "profiler.h"
+
+
+profile_t *profile_create() {
+    profile_t *profile = calloc(1, sizeof(profile_t));
+
+    if (profile != NULL) {
+        profile->frame_min = UINT32_MAX;
+    }
+
+    return profile;
+}
+
+void profile_destroy(profile_t *profile) {
+    free(profile);
+}
+
+void profile_frames(profile_t *profile, uint64_t frames) {
+    uint32_t count = profile->frame_instructions;
+    int bucket = 0;
+
+    if (frames == 0) {
+        return;
+    }
+
+    while (count >> bucket && bucket < PROFILE_FRAME_BUCKETS - 1) {
+        bucket++;
+    }
+
+    profile->frame_histogram[bucket]++;
+    profile->frame_min = count < profile->frame_min ? count : profile->frame_min;
+    profile->frame_max = count > profile->frame_max ? count : profile->frame_max;
+
+    // the frames skipped at once do not execute instructions
+    if (frames > 1) {
+        profile->frame_histogram[0] += frames - 1;
+        profile->frame_min = 0;
+    }
+
+    profile->frames += frames;
+    profile->frame_instructions = 0;
+}
+
+void profile_report(const CHIP8 *chip8, FILE *file) {
+    const profile_t *profile = chip8->profile;
+    uint64_t executed = 0, cycles = 0;
+
+    if (profile == NULL) {
+        fprintf(file, "Profiling is disabled (build with -DCHIP8_PROFILE)\n");
+        return;
+    }
+
+    for (int i = 0; i <= ISA_SIZE; i++) {
+        executed += profile->instructions[i];
+    }
+
+    for (int a = 0; a < 4096; a++) {
+        cycles += profile->addresses[a];
+    }
+
+    fprintf(file, "Profile: %llu instructions executed, %llu idle loop cycles fast-forwarded, "
+                  "%llu cycles waiting for a key\n", (unsigned long long) executed,
+            (unsigned long long) profile->idle_cycles, (unsigned long long) profile->wait_cycles);
+
+    fprintf(file, "\nInstructions:\n");
+    for (int i = 0; i <= ISA_SIZE; i++) {
+        if (profile->instructions[i]) {
+            fprintf(file, "  %-24s %12llu %6.2f%%\n", i < ISA_SIZE ? chip8->ISA[i].name : "unknown",
+                    (unsigned long long) profile->instructions[i], 100.0 * profile->instructions[i] / executed);
+        }
+    }
+
+    // selection of the hottest addresses, in decreasing order
+    int hot[PROFILE_HOT_ADDRESSES];
+    int count = 0;
+
+    for (int a = 0; a < 4096; a++) {
+        if (!profile->addresses[a]) {
+            continue;
+        }
+
+        int position = count < PROFILE_HOT_ADDRESSES ? count++ : PROFILE_HOT_ADDRESSES;
+        while (position > 0 && profile->addresses[hot[position - 1]] < profile->addresses[a]) {
+            if (position < PROFILE_HOT_ADDRESSES) {
+                hot[position] = hot[position - 1];
+            }
+            position--;
+        }
+
+        if (position < PROFILE_HOT_ADDRESSES) {
+            hot[position] = a;
+        }
+    }
+
+    fprintf(file, "\nHot addresses:\n");
+    for (int i = 0; i < count; i++) {
+        uint16_t opcode = (chip8->memory[hot[i]] << 8) | chip8->memory[(hot[i] + 1) & 0xFFF];
+        const instruction_t *instruction = CHIP8_decode_instruction((CHIP8 *) chip8, opcode);
+
+        fprintf(file, "  0x%03X %04X %-24s %12llu %6.2f%%\n", hot[i], opcode,
+                instruction != NULL ? instruction->name : "unknown",
+                (unsigned long long) profile->addresses[hot[i]], 100.0 * profile->addresses[hot[i]] / cycles);
+    }
+
+    fprintf(file, "\nInstructions per frame (%llu frames", (unsigned long long) profile->frames);
+    if (profile->frames) {
+        fprintf(file, ", min %u, average %.1f, max %u", profile->frame_min,
+                (double) (executed - profile->frame_instructions) / profile->frames, profile->frame_max);
+    }
+    fprintf(file, "):\n");
+
+    for (int b = 0; b < PROFILE_FRAME_BUCKETS; b++) {
+        if (!profile->frame_histogram[b]) {
+            continue;
+        }
+
+        char range[32];
+
+        if (b == 0) {
+            snprintf(range, sizeof(range), "0");
+        } else if (b == PROFILE_FRAME_BUCKETS - 1) {
+            snprintf(range, sizeof(range), "%u+", 1u << (b - 1));
+        } else {
+            snprintf(range, sizeof(range), "%u-%u", 1u << (b - 1), (1u << b) - 1);
+        }
+
+        fprintf(file, "  %-14s%12llu\n", range, (unsigned long long) profile->frame_histogram[b]);
+    }
+}
\ No newline at end of file
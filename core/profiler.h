@@ -0,0 +1,90 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "CHIP-8.h"
+
+/**
+ * Buckets of the histogram of the instructions executed in a frame:
+ * bucket 0 counts the frames without instructions, bucket b the frames
+ * with [2^(b-1), 2^b) instructions, the last one all the longer frames.
+ */
+#define PROFILE_FRAME_BUCKETS 16
+
+/**
+ * Number of addresses listed in the report
+ */
+#define PROFILE_HOT_ADDRESSES 16
+
+/**
+ * Counters of a profiled emulator (see CHIP8_set_profiling).
+ *
+ * The profiler is compiled in with -DCHIP8_PROFILE. While it is enabled,
+ * every instruction is counted, so the engines run their blocks one
+ * instruction at a time: superinstructions, JIT and AOT translations
+ * are not used.
+ */
+struct profile_s {
+    // executions of each ISA entry, the last entry counts unknown opcodes
+    uint64_t instructions[ISA_SIZE + 1];
+
+    // cycles spent at each address, idle loop fast-forwards included
+    uint64_t addresses[4096];
+
+    // cycles fast-forwarded in idle loops, and spent waiting for a key
+    uint64_t idle_cycles;
+    uint64_t wait_cycles;
+
+    // instructions executed in each 60 Hz frame
+    uint64_t frames;
+    uint32_t frame_instructions;
+    uint32_t frame_min;
+    uint32_t frame_max;
+    uint64_t frame_histogram[PROFILE_FRAME_BUCKETS];
+};
+
+typedef struct profile_s profile_t;
+
+/**
+ * @return new zeroed counters, or NULL if they cannot be allocated
+ */
+extern profile_t *profile_create();
+
+/**
+ * @param profile are the counters to free
+ */
+extern void profile_destroy(profile_t *profile);
+
+/**
+ * Account for the end of frames: the first one gets the instructions
+ * counted since the previous frame, the others are empty.
+ *
+ * @param profile is a pointer to the counters
+ * @param frames is the number of frames that ended
+ */
+extern void profile_frames(profile_t *profile, uint64_t frames);
+
+/**
+ * Write the report of a profiled emulator: instructions executed per
+ * ISA entry, hottest addresses and instructions executed per frame.
+ *
+ * @param chip8 is a pointer to the emulator
+ * @param file is the output file
+ */
+extern void profile_report(const CHIP8 *chip8, FILE *file);
+
+/**
+ * Count an instruction executed at the given address
+ *
+ * @param profile is a pointer to the counters
+ * @param address is the address of the instruction
+ * @param index is the ISA entry of the instruction, ISA_SIZE if unknown
+ */
+static inline void profile_instruction(profile_t *profile, uint16_t address, uint8_t index) {
+    profile->instructions[index]++;
+    profile->addresses[address & 0xFFF]++;
+    profile->frame_instructions++;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rewind_buffer.h"
+
+/**
+ * Number of equal bytes that ends a literal: shorter runs are cheaper
+ * to store in the literal than to skip
+ */
+#define MIN_SKIP 3
+
+/**
+ * Average budget per snapshot used to size the ring of entries
+ */
+#define BYTES_PER_ENTRY 64
+
+#define ENTRY(buffer, i) (&(buffer)->entries[((buffer)->first + (i)) % (buffer)->max_entries])
+
+static const uint8_t zero_image[CHIP8_STATE_SIZE];
+
+static uint32_t encode(const uint8_t *image, const uint8_t *base, uint8_t *out);
+
+static void decode(const uint8_t *record, uint32_t length, uint8_t *image);
+
+static uint32_t allocate(rewind_buffer_t *buffer, uint32_t length);
+
+static void drop_oldest(rewind_buffer_t *buffer);
+
+static uint64_t load64(const uint8_t *p);
+
+
+rewind_buffer_t *rewind_buffer_create(uint32_t budget, uint32_t keyframe_interval) {
+    if (budget < REWIND_MIN_BUDGET || keyframe_interval == 0) {
+        return NULL;
+    }
+
+    rewind_buffer_t *buffer = malloc(sizeof(rewind_buffer_t));
+    if (!buffer) {
+        return NULL;
+    }
+
+    // the budget is shared by the entries and the encoded snapshots
+    buffer->max_entries = budget / BYTES_PER_ENTRY;
+    buffer->capacity = budget - buffer->max_entries * sizeof(rewind_entry_t);
+    buffer->entries = malloc(buffer->max_entries * sizeof(rewind_entry_t));
+    buffer->data = malloc(buffer->capacity);
+
+    if (!buffer->entries || !buffer->data) {
+        rewind_buffer_destroy(buffer);
+        return NULL;
+    }
+
+    buffer->head = 0;
+    buffer->first = 0;
+    buffer->count = 0;
+    buffer->keyframe_interval = keyframe_interval;
+    buffer->since_keyframe = 0;
+    buffer->last_frame = 0;
+
+    return buffer;
+}
+
+void rewind_buffer_destroy(rewind_buffer_t *buffer) {
+    free(buffer->entries);
+    free(buffer->data);
+    free(buffer);
+}
+
+int rewind_buffer_record(rewind_buffer_t *buffer, const CHIP8 *chip8) {
+    if (buffer->count && chip8->frame_count == buffer->last_frame) {
+        return 0;
+    }
+
+    CHIP8_save_state(chip8, buffer->image);
+
+    int keyframe = buffer->count == 0 || buffer->since_keyframe >= buffer->keyframe_interval;
+    uint32_t length = encode(buffer->image, keyframe ? zero_image : buffer->keyframe, buffer->record);
+    uint32_t offset = allocate(buffer, length);
+
+    if (!keyframe && buffer->count == 0) {
+        // the space was made by dropping the keyframe of the delta
+        keyframe = 1;
+        length = encode(buffer->image, zero_image, buffer->record);
+        offset = allocate(buffer, length);
+    }
+
+    memcpy(buffer->data + offset, buffer->record, length);
+
+    rewind_entry_t *entry = ENTRY(buffer, buffer->count);
+    entry->offset = offset;
+    entry->length = length;
+    entry->keyframe = (uint8_t) keyframe;
+
+    buffer->count++;
+    buffer->head = offset + length;
+    buffer->last_frame = chip8->frame_count;
+
+    if (keyframe) {
+        memcpy(buffer->keyframe, buffer->image, CHIP8_STATE_SIZE);
+        buffer->since_keyframe = 0;
+    }
+    buffer->since_keyframe++;
+
+    return 1;
+}
+
+int rewind_buffer_step_back(rewind_buffer_t *buffer, CHIP8 *chip8, int snapshots) {
+    if (buffer->count == 0 || snapshots < 0) {
+        return 0;
+    }
+
+    if ((uint32_t) snapshots > buffer->count - 1) {
+        snapshots = (int) buffer->count - 1;
+    }
+
+    uint32_t target = buffer->count - 1 - snapshots;
+    uint32_t keyframe = target;
+
+    while (!ENTRY(buffer, keyframe)->keyframe) {
+        keyframe--;
+    }
+
+    // a keyframe and at most one delta, whose base is the keyframe
+    const rewind_entry_t *base = ENTRY(buffer, keyframe);
+    memset(buffer->image, 0, CHIP8_STATE_SIZE);
+    decode(buffer->data + base->offset, base->length, buffer->image);
+
+    const rewind_entry_t *entry = ENTRY(buffer, target);
+    if (target != keyframe) {
+        decode(buffer->data + entry->offset, entry->length, buffer->image);
+    }
+
+    // the newest keyframe is still the base of the new deltas
+    if (!CHIP8_load_state(chip8, buffer->image, CHIP8_STATE_SIZE)) {
+        return -1;
+    }
+
+    memset(buffer->keyframe, 0, CHIP8_STATE_SIZE);
+    decode(buffer->data + base->offset, base->length, buffer->keyframe);
+
+    // the restored snapshot becomes the newest one
+    buffer->count = target + 1;
+    buffer->head = entry->offset + entry->length;
+    buffer->since_keyframe = target - keyframe + 1;
+    buffer->last_frame = chip8->frame_count;
+
+    return snapshots;
+}
+
+/**
+ * Encode the XOR of an image with its base.
+ *
+ * @return the length of the encoded snapshot
+ */
+static uint32_t encode(const uint8_t *image, const uint8_t *base, uint8_t *out) {
+    uint8_t *p = out;
+    int i = 0;
+
+    while (i < CHIP8_STATE_SIZE) {
+        int start = i;
+
+        while (i + 64 <= CHIP8_STATE_SIZE && !memcmp(image + i, base + i, 64)) {
+            i += 64;
+        }
+        while (i + 8 <= CHIP8_STATE_SIZE && load64(image + i) == load64(base + i)) {
+            i += 8;
+        }
+        while (i < CHIP8_STATE_SIZE && image[i] == base[i]) {
+            i++;
+        }
+
+        if (i == CHIP8_STATE_SIZE) {
+            break;
+        }
+
+        // the literal ends at the first run of MIN_SKIP equal bytes
+        int literal = i, equal = 0;
+        while (i < CHIP8_STATE_SIZE && equal < MIN_SKIP) {
+            equal = image[i] == base[i] ? equal + 1 : 0;
+            i++;
+        }
+        i -= equal;
+
+        int counts[2] = {literal - start, i - literal};
+        for (int c = 0; c < 2; c++) {
+            uint32_t value = counts[c];
+
+            // LEB128
+            do {
+                *p++ = (uint8_t) ((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+                value >>= 7;
+            } while (value);
+        }
+
+        for (int j = literal; j < i; j++) {
+            *p++ = image[j] ^ base[j];
+        }
+    }
+
+    return p - out;
+}
+
+/**
+ * Apply an encoded snapshot to the image holding its base.
+ */
+static void decode(const uint8_t *record, uint32_t length, uint8_t *image) {
+    const uint8_t *p = record, *end = record + length;
+    uint32_t position = 0;
+
+    while (p < end) {
+        uint32_t counts[2] = {0, 0};
+
+        for (int c = 0; c < 2; c++) {
+            int shift = 0;
+
+            do {
+                counts[c] |= (uint32_t) (*p & 0x7F) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+        }
+
+        position += counts[0];
+        for (uint32_t j = 0; j < counts[1]; j++) {
+            image[position++] ^= *p++;
+        }
+    }
+}
+
+/**
+ * Find room for a snapshot in the data ring, dropping the oldest
+ * snapshots that are in the way.
+ *
+ * @return the offset of the snapshot
+ */
+static uint32_t allocate(rewind_buffer_t *buffer, uint32_t length) {
+    uint32_t offset = buffer->head;
+
+    if (buffer->count == buffer->max_entries) {
+        drop_oldest(buffer);
+    }
+
+    if (offset + length > buffer->capacity) {
+        // the end of the ring is left unused: the snapshots there are the oldest ones
+        while (buffer->count && ENTRY(buffer, 0)->offset >= buffer->head) {
+            drop_oldest(buffer);
+        }
+
+        offset = 0;
+    }
+
+    while (buffer->count && ENTRY(buffer, 0)->offset < offset + length
+           && offset < ENTRY(buffer, 0)->offset + ENTRY(buffer, 0)->length) {
+        drop_oldest(buffer);
+    }
+
+    return offset;
+}
+
+/**
+ * Drop the oldest keyframe and its deltas.
+ */
+static void drop_oldest(rewind_buffer_t *buffer) {
+    do {
+        buffer->first = (buffer->first + 1) % buffer->max_entries;
+        buffer->count--;
+    } while (buffer->count && !ENTRY(buffer, 0)->keyframe);
+}
+
+/**
+ * Load 8 unaligned bytes.
+ */
+static uint64_t load64(const uint8_t *p) {
+    uint64_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
@@ -0,0 +1,113 @@
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include <stdint.h>
+#include "CHIP-8.h"
+
+/**
+ * Maximum size of an encoded snapshot
+ */
+#define REWIND_MAX_RECORD (CHIP8_STATE_SIZE + CHIP8_STATE_SIZE / 2 + 16)
+
+/**
+ * Smallest memory budget accepted by rewind_buffer_create
+ */
+#define REWIND_MIN_BUDGET (4 * REWIND_MAX_RECORD)
+
+/**
+ * A snapshot stored in the ring: its position in the data ring,
+ * its encoded size and whether it is a keyframe.
+ */
+struct rewind_entry_s {
+    uint32_t offset;
+    uint32_t length;
+    uint8_t keyframe;
+};
+
+typedef struct rewind_entry_s rewind_entry_t;
+
+/**
+ * Rewind buffer: a ring holding a snapshot of the machine per frame.
+ *
+ * Every keyframe_interval snapshots a keyframe is stored; the other
+ * snapshots are deltas against the last keyframe. Both are the XOR of
+ * the save state image (see CHIP8_save_state) with a base (zero for
+ * keyframes, the keyframe image for deltas), encoded as runs:
+ *
+ *   [zero bytes to skip][length of the literal][literal XOR bytes] ...
+ *
+ * where the counts are LEB128 varints and the trailing zeros are omitted.
+ * Restoring any snapshot costs one keyframe and at most one delta.
+ *
+ * When the memory budget is exhausted, the oldest keyframe is dropped
+ * together with its deltas.
+ */
+struct rewind_buffer_s {
+    // ring of encoded snapshots, and offset following the newest one
+    uint8_t *data;
+    uint32_t capacity;
+    uint32_t head;
+
+    // ring of entries, from the oldest snapshot to the newest one
+    rewind_entry_t *entries;
+    uint32_t max_entries;
+    uint32_t first;
+    uint32_t count;
+
+    uint32_t keyframe_interval;
+    uint32_t since_keyframe;
+
+    // frame of the emulator at the last snapshot
+    uint64_t last_frame;
+
+    // image of the newest keyframe, base of the new deltas (aligned for fast copies)
+    _Alignas(8) uint8_t keyframe[CHIP8_STATE_SIZE];
+
+    _Alignas(8) uint8_t image[CHIP8_STATE_SIZE];
+    uint8_t record[REWIND_MAX_RECORD];
+};
+
+typedef struct rewind_buffer_s rewind_buffer_t;
+
+/**
+ * Allocate an empty rewind buffer.
+ *
+ * @param budget is the memory used by the snapshots, in bytes
+ * @param keyframe_interval is the number of snapshots between two keyframes
+ * @return the rewind buffer, or NULL if the budget is smaller than
+ *         REWIND_MIN_BUDGET or the allocation failed
+ */
+extern rewind_buffer_t *rewind_buffer_create(uint32_t budget, uint32_t keyframe_interval);
+
+/**
+ * Free a rewind buffer.
+ *
+ * @param buffer is a pointer to the rewind buffer
+ */
+extern void rewind_buffer_destroy(rewind_buffer_t *buffer);
+
+/**
+ * Take a snapshot of the machine if a frame ended since the last one.
+ * Meant to be called after every run of the emulator: at most one
+ * snapshot is taken per call.
+ *
+ * @param buffer is a pointer to the rewind buffer
+ * @param chip8 is a pointer to the emulator
+ * @return 1 if a snapshot was taken, 0 otherwise
+ */
+extern int rewind_buffer_record(rewind_buffer_t *buffer, const CHIP8 *chip8);
+
+/**
+ * Restore the machine as it was a number of snapshots ago, and discard
+ * the newer snapshots. The oldest snapshot is restored if the buffer
+ * does not go back that far.
+ *
+ * @param buffer is a pointer to the rewind buffer
+ * @param chip8 is a pointer to the emulator
+ * @param snapshots is the number of snapshots to go back
+ * @return the number of snapshots actually gone back, -1 if the snapshot
+ *         could not be restored (the buffer and the machine are unchanged)
+ */
+extern int rewind_buffer_step_back(rewind_buffer_t *buffer, CHIP8 *chip8, int snapshots);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stddef.h>
+
+#include "superinstructions.h"
+#include "instructions.h"
+
+/**
+ * Instructions of a superinstruction, one macro per instruction of the ISA.
+ *
+ * The instructions that only work on the registers, I and PC are inlined
+ * on the decoded operands (same semantics as instructions.c). They do not
+ * observe the timers, the keyboard or the screen, so their cycles are
+ * completed together, before the next instruction that does or at the end
+ * of the superinstruction, as the JIT does. The other instructions call
+ * their handler and complete their cycle as CHIP8_tick does.
+ */
+#define V(r) chip8->register_file.raw[r]
+
+#define SUPER_INLINE(body) \
+    body; \
+    pending++
+
+#define SUPER_CALL(execute, op) \
+    SUPER_RETIRE(); \
+    chip8->draw_flag = 0; \
+    execute(chip8, (op)->opcode); \
+    CHIP8_end_cycle(chip8)
+
+#define SUPER_SKIP(condition) SUPER_INLINE(if (condition) chip8->PC = chip8->PC + 2)
+
+#define SUPER_RETIRE() \
+    if (pending) { \
+        CHIP8_end_cycles(chip8, pending); \
+        pending = 0; \
+    }
+
+#define SUPER_OP_sys(op) SUPER_INLINE((void) (op))
+#define SUPER_OP_clear_screen(op) SUPER_CALL(clear_screen, op)
+#define SUPER_OP_ret(op) SUPER_CALL(ret, op)
+#define SUPER_OP_jump_immediate(op) SUPER_CALL(jump_immediate, op)
+#define SUPER_OP_call(op) SUPER_CALL(call, op)
+#define SUPER_OP_skip_equal_imm(op) SUPER_SKIP(V((op)->x) == (op)->kk)
+#define SUPER_OP_skip_not_equal_imm(op) SUPER_SKIP(V((op)->x) != (op)->kk)
+#define SUPER_OP_skip_equal_reg(op) SUPER_SKIP(V((op)->x) == V((op)->y))
+#define SUPER_OP_load_immediate(op) SUPER_INLINE(V((op)->x) = (op)->kk)
+#define SUPER_OP_add_immediate(op) SUPER_INLINE(V((op)->x) += (op)->kk)
+#define SUPER_OP_mov(op) SUPER_INLINE(V((op)->x) = V((op)->y))
+#define SUPER_OP_or(op) SUPER_INLINE(V((op)->x) |= V((op)->y))
+#define SUPER_OP_and(op) SUPER_INLINE(V((op)->x) &= V((op)->y))
+#define SUPER_OP_xor(op) SUPER_INLINE(V((op)->x) ^= V((op)->y))
+#define SUPER_OP_add_reg(op) SUPER_INLINE( \
+    uint16_t sum = V((op)->x) + V((op)->y); \
+    V((op)->x) = sum & 0xFF; \
+    chip8->register_file.VF = sum >> 8)
+#define SUPER_OP_sub(op) SUPER_INLINE( \
+    uint8_t a = V((op)->x); \
+    uint8_t b = V((op)->y); \
+    V((op)->x) = a - b; \
+    chip8->register_file.VF = a > b)
+#define SUPER_OP_shift_right(op) SUPER_INLINE( \
+    chip8->register_file.VF = V((op)->x) & 1; \
+    V((op)->x) = V((op)->x) >> 1)
+#define SUPER_OP_subn(op) SUPER_INLINE( \
+    uint8_t a = V((op)->y); \
+    uint8_t b = V((op)->x); \
+    V((op)->x) = a - b; \
+    chip8->register_file.VF = a > b)
+#define SUPER_OP_shift_left(op) SUPER_INLINE( \
+    chip8->register_file.VF = V((op)->x) >> 7; \
+    V((op)->x) = V((op)->x) << 1)
+#define SUPER_OP_skip_ne_reg(op) SUPER_SKIP(V((op)->x) != V((op)->y))
+#define SUPER_OP_load_index(op) SUPER_INLINE(chip8->I = (op)->nnn)
+#define SUPER_OP_jump_addr(op) SUPER_CALL(jump_addr, op)
+#define SUPER_OP_rnd(op) SUPER_CALL(rnd, op)
+#define SUPER_OP_draw(op) SUPER_CALL(draw, op)
+#define SUPER_OP_skip_if_pressed(op) SUPER_CALL(skip_if_pressed, op)
+#define SUPER_OP_skip_if_not_pressed(op) SUPER_CALL(skip_if_not_pressed, op)
+#define SUPER_OP_load_timer_value(op) SUPER_CALL(load_timer_value, op)
+#define SUPER_OP_load_key(op) SUPER_CALL(load_key, op)
+#define SUPER_OP_set_timer_value(op) SUPER_CALL(set_timer_value, op)
+#define SUPER_OP_set_sound_value(op) SUPER_CALL(set_sound_value, op)
+#define SUPER_OP_add_to_index(op) SUPER_INLINE(chip8->I = chip8->I + V((op)->x))
+#define SUPER_OP_load_sprite_location(op) SUPER_INLINE(chip8->I = MEMORY_FONTSET_START + 5 * V((op)->x))
+#define SUPER_OP_load_bcd_representation(op) SUPER_CALL(load_bcd_representation, op)
+#define SUPER_OP_store_registers(op) SUPER_CALL(store_registers, op)
+#define SUPER_OP_load_registers(op) SUPER_CALL(load_registers, op)
+
+/**
+ * Execute the k-th instruction of a superinstruction
+ */
+#define SUPER_STEP(k, name) \
+    next = chip8->PC + 2; \
+    chip8->PC = next; \
+    { SUPER_OP_##name(&ops[k]); }
+
+/**
+ * Stop after the k-th instruction if it changed the PC (a taken skip)
+ */
+#define SUPER_CONTINUE(k) \
+    if (chip8->PC != next) { \
+        SUPER_RETIRE(); \
+        return (k) + 1; \
+    }
+
+#define SUPERINSTRUCTION_2(a, b) \
+    static int a##__##b(CHIP8 *chip8, const decoded_op_t *ops) { \
+        uint16_t next; \
+        int pending = 0; \
+        SUPER_STEP(0, a); \
+        SUPER_CONTINUE(0); \
+        SUPER_STEP(1, b); \
+        SUPER_RETIRE(); \
+        return 2; \
+    }
+
+#define SUPERINSTRUCTION_3(a, b, c) \
+    static int a##__##b##__##c(CHIP8 *chip8, const decoded_op_t *ops) { \
+        uint16_t next; \
+        int pending = 0; \
+        SUPER_STEP(0, a); \
+        SUPER_CONTINUE(0); \
+        SUPER_STEP(1, b); \
+        SUPER_CONTINUE(1); \
+        SUPER_STEP(2, c); \
+        SUPER_RETIRE(); \
+        return 3; \
+    }
+
+#include "superinstructions.def"
+
+#undef SUPERINSTRUCTION_2
+#undef SUPERINSTRUCTION_3
+
+#define SUPERINSTRUCTION_2(a, b) {2, {&a, &b, NULL}, &a##__##b},
+#define SUPERINSTRUCTION_3(a, b, c) {3, {&a, &b, &c}, &a##__##b##__##c},
+
+static const superinstruction_t superinstructions[] = {
+#include "superinstructions.def"
+        {0, {NULL, NULL, NULL}, NULL}
+};
+
+superinstruction_runner superinstruction_match(const decoded_op_t *ops, int available, int *length) {
+    const superinstruction_t *best = NULL;
+
+    for (const superinstruction_t *s = superinstructions; s->run != NULL; s++) {
+        if (s->length > available || (best != NULL && s->length <= best->length)) {
+            continue;
+        }
+
+        int i = 0;
+        while (i < s->length && ops[i].execute == s->sequence[i]
+               && (i == s->length - 1 || superinstruction_can_continue(ops[i].execute))) {
+            i++;
+        }
+
+        if (i == s->length) {
+            best = s;
+        }
+    }
+
+    if (best == NULL) {
+        return NULL;
+    }
+
+    *length = best->length;
+    return best->run;
+}
+
+int superinstruction_can_continue(instruction_runner execute) {
+    return execute != &ret
+           && execute != &jump_immediate
+           && execute != &call
+           && execute != &jump_addr
+           && execute != &load_key
+           && execute != &load_bcd_representation
+           && execute != &store_registers;
+}
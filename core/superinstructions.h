@@ -0,0 +1,47 @@
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#include "CHIP-8.h"
+#include "block_cache.h"
+
+/**
+ * Maximum number of instructions fused into a superinstruction
+ */
+#define SUPERINSTRUCTION_MAX_LENGTH 3
+
+/**
+ * A sequence of instructions that runs in a single dispatch.
+ *
+ * The available superinstructions are listed in superinstructions.def,
+ * which is generated by chip8_superinstructions from the opcode sequences
+ * recorded while running a set of ROMs with CHIP8_step (the iterations
+ * of the idle loops it fast-forwards are not recorded).
+ */
+struct superinstruction_s {
+    uint8_t length;
+    instruction_runner sequence[SUPERINSTRUCTION_MAX_LENGTH];
+    superinstruction_runner run;
+};
+
+typedef struct superinstruction_s superinstruction_t;
+
+/**
+ * Find the longest superinstruction that matches the given instructions.
+ *
+ * @param ops are the instructions to match
+ * @param available is the number of instructions in ops
+ * @param length is set to the number of fused instructions
+ * @return the function that runs the superinstruction, or NULL if none matches
+ */
+extern superinstruction_runner superinstruction_match(const decoded_op_t *ops, int available, int *length);
+
+/**
+ * Check whether an instruction can be followed by other instructions
+ * in a superinstruction: it must not jump unconditionally, wait for a key
+ * or write to main memory.
+ *
+ * @param execute is the function that executes the instruction
+ */
+extern int superinstruction_can_continue(instruction_runner execute);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include "text_render.h"
+
+/**
+ * Size in pixels of the character cells of each mode
+ */
+static const int cell_width[] = {1, 1, 2};
+static const int cell_height[] = {1, 2, 4};
+
+static int cell_pattern(text_render_mode mode, const uint64_t *video, int row, int col);
+
+static int glyph(text_render_mode mode, int pattern, char *out);
+
+static int advance(text_renderer_t *renderer, const uint64_t *video, int row, int from, int to, char *out);
+
+
+void text_renderer_init(text_renderer_t *renderer, text_render_mode mode) {
+    renderer->mode = mode;
+    renderer->shown_valid = 0;
+    renderer->cursor_row = -1;
+    renderer->cursor_col = -1;
+}
+
+size_t text_renderer_draw(text_renderer_t *renderer, const uint64_t *video, const char **output) {
+    text_render_mode mode = renderer->mode;
+    int rows = VIDEO_HEIGHT / cell_height[mode];
+    int cols = VIDEO_WIDTH / cell_width[mode];
+    char *out = renderer->buffer;
+
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            int pattern = cell_pattern(mode, video, row, col);
+
+            if (renderer->shown_valid && pattern == cell_pattern(mode, renderer->shown, row, col)) {
+                continue;
+            }
+
+            // shortest way to bring the cursor to the cell
+            char move[16];
+            int length = sprintf(move, col ? "\x1b[%d;%dH" : "\x1b[%dH", row + 1, col + 1);
+
+            if (renderer->cursor_row == row && renderer->cursor_col <= col) {
+                length = advance(renderer, video, row, renderer->cursor_col, col, move);
+            } else if (row > 0 && renderer->cursor_row == row - 1) {
+                char next_line[sizeof(move)] = "\r\n";
+                int next_length = 2 + advance(renderer, video, row, 0, col, next_line + 2);
+
+                if (next_length < length) {
+                    memcpy(move, next_line, next_length);
+                    length = next_length;
+                }
+            }
+
+            memcpy(out, move, length);
+            out += length;
+            out += glyph(mode, pattern, out);
+
+            renderer->cursor_row = row;
+            renderer->cursor_col = col + 1;
+        }
+    }
+
+    memcpy(renderer->shown, video, sizeof(renderer->shown));
+    renderer->shown_valid = 1;
+
+    *output = renderer->buffer;
+    return out - renderer->buffer;
+}
+
+/**
+ * Pack the pixels of a cell, in the order of the bits of its glyph.
+ */
+static int cell_pattern(text_render_mode mode, const uint64_t *video, int row, int col) {
+    if (mode == TEXT_RENDER_CELLS) {
+        return (int) (video[row] >> (63 - col)) & 1;
+    } else if (mode == TEXT_RENDER_HALF_BLOCKS) {
+        return (int) ((video[2 * row] >> (63 - col)) & 1) | (int) ((video[2 * row + 1] >> (63 - col)) & 1) << 1;
+    }
+
+    // braille dots 1-2-3-7 are the left column, 4-5-6-8 the right one
+    const uint64_t *pixels = &video[4 * row];
+    int shift = 62 - 2 * col;
+    int pattern = 0;
+
+    for (int y = 0; y < 3; y++) {
+        int pair = (int) (pixels[y] >> shift) & 3;
+        pattern |= (pair >> 1) << y | (pair & 1) << (y + 3);
+    }
+
+    int pair = (int) (pixels[3] >> shift) & 3;
+    return pattern | (pair >> 1) << 6 | (pair & 1) << 7;
+}
+
+/**
+ * Write the UTF-8 glyph of a cell pattern, blank cells are spaces.
+ *
+ * @return the length of the glyph in bytes
+ */
+static int glyph(text_render_mode mode, int pattern, char *out) {
+    static const char *half_blocks[] = {" ", "▀", "▄", "█"};
+
+    if (mode == TEXT_RENDER_CELLS || pattern == 0) {
+        out[0] = pattern ? '0' : ' ';
+        return 1;
+    } else if (mode == TEXT_RENDER_HALF_BLOCKS) {
+        memcpy(out, half_blocks[pattern], 3);
+        return 3;
+    }
+
+    // U+2800 + pattern
+    out[0] = (char) 0xE2;
+    out[1] = (char) (0xA0 | pattern >> 6);
+    out[2] = (char) (0x80 | (pattern & 0x3F));
+    return 3;
+}
+
+/**
+ * Move the cursor forward from the cell 'from' to the cell 'to' of a row,
+ * either by writing the glyphs of the new frame for the cells in between
+ * or with a cursor forward sequence, whichever is shorter.
+ *
+ * @return the length of the output in bytes
+ */
+static int advance(text_renderer_t *renderer, const uint64_t *video, int row, int from, int to, char *out) {
+    int forward = to - from == 1 ? 3 : to - from < 10 ? 4 : 5;
+    int length = 0;
+    int col = from;
+
+    // the reprint is abandoned as soon as it gets longer than the cursor forward
+    for (; col < to && length <= forward; col++) {
+        length += glyph(renderer->mode, cell_pattern(renderer->mode, video, row, col), out + length);
+    }
+
+    if (col < to || length > forward) {
+        return to - from == 1 ? sprintf(out, "\x1b[C") : sprintf(out, "\x1b[%dC", to - from);
+    }
+
+    return length;
+}
@@ -0,0 +1,75 @@
+#ifndef TEXT_RENDER_H
+#define TEXT_RENDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "CHIP-8.h"
+
+/**
+ * Size of the output buffer, large enough to redraw every cell
+ * of the screen in any mode
+ */
+#define TEXT_RENDER_BUFFER_SIZE 32768
+
+/**
+ * Glyphs used to draw the screen on a text terminal:
+ *  - TEXT_RENDER_CELLS draws a pixel per character cell ('0' when lit),
+ *    and needs a 64x32 terminal
+ *  - TEXT_RENDER_HALF_BLOCKS packs two vertical pixels per cell in the
+ *    Unicode half blocks, and needs a 64x16 terminal
+ *  - TEXT_RENDER_BRAILLE packs 2x4 pixels per cell in the Unicode
+ *    braille patterns, and needs a 32x8 terminal
+ */
+typedef enum {
+    TEXT_RENDER_CELLS,
+    TEXT_RENDER_HALF_BLOCKS,
+    TEXT_RENDER_BRAILLE
+} text_render_mode;
+
+/**
+ * Renderer translating frames into the escape sequences and UTF-8
+ * glyphs that update a VT100-compatible terminal.
+ */
+struct text_renderer_s {
+    text_render_mode mode;
+
+    /**
+     * Frame on the terminal, valid only when shown_valid is set
+     */
+    uint64_t shown[VIDEO_HEIGHT];
+    uint8_t shown_valid;
+
+    /**
+     * Cursor position on the terminal (0-based), -1 if unknown
+     */
+    int cursor_row;
+    int cursor_col;
+
+    char buffer[TEXT_RENDER_BUFFER_SIZE];
+};
+
+typedef struct text_renderer_s text_renderer_t;
+
+/**
+ * Initialize a renderer. The first frame redraws the whole screen.
+ *
+ * @param renderer is a pointer to the renderer
+ * @param mode selects the glyphs used to draw the pixels
+ */
+extern void text_renderer_init(text_renderer_t *renderer, text_render_mode mode);
+
+/**
+ * Build the output that turns the frame on the terminal into a new frame.
+ *
+ * Only the cells whose glyph changed are written. Between two changed
+ * cells the cursor is moved with the shortest sequence: reprinting the
+ * cells in between, a cursor forward, a new line or an absolute move.
+ *
+ * @param renderer is a pointer to the renderer
+ * @param video is a pointer to the rows of the new frame
+ * @param output is set to the output, valid until the next call
+ * @return the length of the output in bytes, 0 if nothing changed
+ */
+extern size_t text_renderer_draw(text_renderer_t *renderer, const uint64_t *video, const char **output);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trace_buffer.h"
+
+#define HEADER_SIZE 24
+
+static const int dump_signals[] = {SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGTERM, SIGINT, SIGUSR1};
+
+#define NUM_DUMP_SIGNALS (sizeof(dump_signals) / sizeof(dump_signals[0]))
+
+/**
+ * Buffer dumped by the signal handler, and file receiving the dump
+ */
+static trace_buffer_t *signal_buffer;
+static int signal_fd = -1;
+
+static int write_all(int fd, const void *data, size_t length);
+
+static void dump_signal_handler(int signal);
+
+
+trace_buffer_t *trace_buffer_create(uint32_t capacity) {
+    uint32_t size = 1;
+
+    while (size < capacity && size < (1u << 31)) {
+        size <<= 1;
+    }
+
+    trace_buffer_t *buffer = calloc(1, sizeof(trace_buffer_t) + size * sizeof(trace_entry_t));
+
+    if (buffer != NULL) {
+        buffer->mask = size - 1;
+    }
+
+    return buffer;
+}
+
+void trace_buffer_destroy(trace_buffer_t *buffer) {
+    if (signal_buffer == buffer) {
+        signal_buffer = NULL;
+    }
+
+    free(buffer);
+}
+
+int trace_buffer_dump(const trace_buffer_t *buffer, int fd) {
+    uint64_t capacity = (uint64_t) buffer->mask + 1;
+    uint64_t next = buffer->next;
+    uint32_t count = next < capacity ? (uint32_t) next : (uint32_t) capacity;
+    uint32_t oldest = (uint32_t) ((next - count) & buffer->mask);
+    uint8_t header[HEADER_SIZE] = {0};
+
+    memcpy(header, TRACE_MAGIC, 4);
+    header[4] = TRACE_VERSION;
+    memcpy(header + 8, &count, 4);
+    memcpy(header + 16, &buffer->last_cycle, 8);
+
+    // the ring is written in two parts: from the oldest entry to the end, then from the start
+    uint32_t first = count < capacity - oldest ? count : (uint32_t) (capacity - oldest);
+
+    return write_all(fd, header, HEADER_SIZE)
+           && write_all(fd, &buffer->entries[oldest], first * sizeof(trace_entry_t))
+           && write_all(fd, buffer->entries, (count - first) * sizeof(trace_entry_t));
+}
+
+int trace_buffer_dump_on_signal(trace_buffer_t *buffer, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        return 0;
+    }
+
+    if (signal_fd >= 0) {
+        close(signal_fd);
+    }
+
+    signal_buffer = buffer;
+    signal_fd = fd;
+
+    for (size_t i = 0; i < NUM_DUMP_SIGNALS; i++) {
+        struct sigaction action = {0};
+
+        action.sa_handler = &dump_signal_handler;
+        sigemptyset(&action.sa_mask);
+
+        // a crash in the handler must not call it again
+        action.sa_flags = dump_signals[i] == SIGUSR1 ? SA_RESTART : SA_RESETHAND;
+        sigaction(dump_signals[i], &action, NULL);
+    }
+
+    return 1;
+}
+
+/**
+ * Write a whole block of data, resuming after partial writes
+ */
+static int write_all(int fd, const void *data, size_t length) {
+    const uint8_t *p = data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+
+        if (written <= 0) {
+            return 0;
+        }
+
+        p += written;
+        length -= written;
+    }
+
+    return 1;
+}
+
+/**
+ * Dump the buffer, then let the other signals than SIGUSR1
+ * terminate the process as they would have done
+ */
+static void dump_signal_handler(int signal) {
+    if (signal_buffer != NULL) {
+        lseek(signal_fd, 0, SEEK_SET);
+        ftruncate(signal_fd, 0);
+        trace_buffer_dump(signal_buffer, signal_fd);
+    }
+
+    if (signal != SIGUSR1) {
+        raise(signal);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "CHIP-8.h"
+
+#define TRACE_MAGIC "C8TR"
+#define TRACE_VERSION 1
+
+/**
+ * Value of the register field of an entry when no register changed,
+ * and flag added to it when VF changed besides the register
+ */
+#define TRACE_NO_REGISTER 0xFF
+#define TRACE_FLAG_CHANGED 0x10
+
+/**
+ * An executed instruction (12 bytes). The cycle is truncated to its
+ * low 32 bits: the dump stores the full cycle of the newest entry,
+ * from which the others are recovered.
+ */
+struct trace_entry_s {
+    uint32_t cycle;
+    uint16_t PC;
+    uint16_t opcode;
+
+    // I after the instruction
+    uint16_t I;
+
+    // first register changed by the instruction and its new value
+    uint8_t reg;
+    uint8_t value;
+};
+
+typedef struct trace_entry_s trace_entry_t;
+
+/**
+ * Ring buffer of the last instructions executed by an emulator
+ * (see CHIP8_set_trace).
+ *
+ * Recording an instruction only writes an entry of the buffer, which
+ * is allocated once: the tracer can be left on. While it is attached,
+ * the engines run their blocks one instruction at a time (no
+ * superinstructions, JIT or AOT translations), and the iterations of
+ * the idle loops that are fast-forwarded are not recorded.
+ *
+ * Dump format (host byte order): magic (4 bytes), version (1 byte),
+ * padding (3 bytes), number of entries (4 bytes), padding (4 bytes),
+ * full cycle of the newest entry (8 bytes), then the entries from
+ * the oldest to the newest.
+ */
+struct trace_buffer_s {
+    uint64_t next;
+    uint32_t mask;
+
+    // cycle of the newest entry
+    uint64_t last_cycle;
+
+    // registers before the instruction being executed
+    uint64_t registers[2];
+
+    trace_entry_t entries[];
+};
+
+typedef struct trace_buffer_s trace_buffer_t;
+
+/**
+ * Allocate a trace buffer.
+ *
+ * @param capacity is the number of entries, rounded up to a power of two
+ * @return the buffer, or NULL if it cannot be allocated
+ */
+extern trace_buffer_t *trace_buffer_create(uint32_t capacity);
+
+/**
+ * @param buffer is the buffer to free
+ */
+extern void trace_buffer_destroy(trace_buffer_t *buffer);
+
+/**
+ * Write the entries of the buffer to a file descriptor, from the oldest
+ * to the newest. Only write(2) is used, so the function can be called
+ * from a signal handler.
+ *
+ * @param buffer is a pointer to the buffer
+ * @param fd is the file descriptor
+ * @return 1 on success, 0 if the dump could not be written
+ */
+extern int trace_buffer_dump(const trace_buffer_t *buffer, int fd);
+
+/**
+ * Dump the buffer to a file when the process crashes or is terminated
+ * (SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGTERM, SIGINT) and at
+ * every SIGUSR1. The file is overwritten at every dump. A single buffer
+ * can be dumped by signals.
+ *
+ * @param buffer is a pointer to the buffer
+ * @param path is the path of the dump
+ * @return 1 on success, 0 if the file cannot be opened
+ */
+extern int trace_buffer_dump_on_signal(trace_buffer_t *buffer, const char *path);
+
+/**
+ * Remember the registers before an instruction. Called by the emulator.
+ */
+static inline void trace_begin(trace_buffer_t *buffer, const CHIP8 *chip8) {
+    memcpy(buffer->registers, chip8->register_file.raw, 16);
+}
+
+/**
+ * Record an executed instruction. Called by the emulator.
+ *
+ * @param buffer is a pointer to the buffer
+ * @param chip8 is a pointer to the emulator, after the instruction
+ * @param address is the address of the instruction
+ * @param opcode is the opcode of the instruction
+ */
+static inline void trace_end(trace_buffer_t *buffer, const CHIP8 *chip8, uint16_t address, uint16_t opcode) {
+    trace_entry_t *entry = &buffer->entries[buffer->next++ & buffer->mask];
+    uint64_t after[2];
+
+    memcpy(after, chip8->register_file.raw, 16);
+
+    entry->cycle = (uint32_t) chip8->cycle_count;
+    entry->PC = address;
+    entry->opcode = opcode;
+    entry->I = chip8->I;
+    entry->reg = TRACE_NO_REGISTER;
+
+    // bytes of the registers that differ, VF is the last byte
+    uint64_t low = buffer->registers[0] ^ after[0];
+    uint64_t high = buffer->registers[1] ^ after[1];
+
+    if (low | high) {
+        const uint8_t *registers = chip8->register_file.raw;
+        int changed;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t flag = high & 0xFF00000000000000ULL;
+
+        high &= ~0xFF00000000000000ULL;
+        changed = low ? __builtin_ctzll(low) >> 3 : high ? 8 + (__builtin_ctzll(high) >> 3) : 15;
+#else
+        const uint8_t *before = (const uint8_t *) buffer->registers;
+        int flag = before[15] != registers[15];
+
+        for (changed = 0; changed < 15 && before[changed] == registers[changed]; changed++);
+#endif
+
+        entry->reg = changed < 15 && flag ? changed | TRACE_FLAG_CHANGED : changed;
+        entry->value = registers[changed];
+    }
+
+    buffer->last_cycle = chip8->cycle_count;
+}
+
+#endif
\ No newline at end of file
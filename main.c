@@ -1,35 +1,284 @@
 #include <unistd.h>
+#include <string.h>
 #include <curses.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 
 #include "core/CHIP-8.h"
+#include "core/key_queue.h"
+#include "core/frame_buffer.h"
+#include "core/text_render.h"
+#include "core/rewind_buffer.h"
+#include "core/input_record.h"
+#include "core/profiler.h"
+#include "core/trace_buffer.h"
+
+/**
+ * Maximum number of cycles executed before reading the keyboard again
+ */
+#define RUN_BUDGET 4096
+
+/**
+ * Time after which a key is released if the terminal does not
+ * repeat it, in milliseconds
+ */
+#define KEY_HOLD_TIME 300
+
+/**
+ * Rewind: the key that steps back in time, the number of frames
+ * undone by each press, and the memory kept for the past frames
+ */
+#define REWIND_KEY 'b'
+#define REWIND_STEP 6
+#define REWIND_BUDGET (4 * 1024 * 1024)
+#define REWIND_KEYFRAME_INTERVAL 60
+
+/**
+ * Key that writes the profiler report (see the -f option)
+ */
+#define PROFILE_KEY 'p'
+
+/**
+ * Tracer: the key that writes the trace (see the -T option),
+ * and the number of instructions kept in the trace
+ */
+#define TRACE_KEY 't'
+#define TRACE_ENTRIES (1 << 16)
 
 void window_setup();
 
-void refresh_screen(const uint8_t *video);
+void refresh_screen(const uint64_t *video);
 
 void emit_beep();
 
-void keyboard_input(uint8_t *keyboard);
+void *render_thread(void *arg);
+
+void *input_thread(void *arg);
+
+int key_index(char key);
+
+int render_mode(const char *name);
+
+int64_t time_ms();
+
+/**
+ * Key events read by the input thread, and event file descriptor
+ * used by the input thread to wake up the main loop
+ */
+key_queue_t key_queue;
+int key_event;
+
+/**
+ * Frames published by the emulator, beeps not emitted yet, and event
+ * file descriptor used by the emulator to wake up the render thread
+ */
+frame_buffer_t frame_buffer;
+_Atomic int pending_beeps;
+int frame_event;
+
+/**
+ * Presses of the rewind key not handled yet by the main loop
+ */
+_Atomic int rewind_requests;
+
+/**
+ * Presses of the profile key not handled yet by the main loop
+ */
+_Atomic int profile_requests;
+
+/**
+ * Presses of the trace key not handled yet by the main loop
+ */
+_Atomic int trace_requests;
+
+/**
+ * Renderer used by the render thread to update the terminal
+ */
+text_renderer_t renderer;
+
+#ifdef CHIP8_AOT
+/**
+ * ROM translated to C by chip8_aot (see the 'native' target)
+ */
+extern const CHIP8_program CHIP8_translated_program;
+#endif
 
 int main(int argc, char **argv) {
     CHIP8 chip8;
+    int mode = TEXT_RENDER_HALF_BLOCKS;
+    const char *record_path = NULL, *replay_path = NULL, *profile_path = NULL;
+    const char *trace_path = NULL;
+    int first = 1;
 
-    if (argc != 2) {
-        fprintf(stdout, "USAGE: ./chip8 /path/to/rom");
-        return 1;
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-m")) {
+            mode = render_mode(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-R")) {
+            record_path = argv[first + 1];
+        } else if (!strcmp(argv[first], "-P")) {
+            replay_path = argv[first + 1];
+        } else if (!strcmp(argv[first], "-f")) {
+            profile_path = argv[first + 1];
+        } else if (!strcmp(argv[first], "-T")) {
+            trace_path = argv[first + 1];
+        } else {
+            break;
+        }
+
+        first += 2;
     }
 
-    window_setup();
+#ifdef CHIP8_AOT
+    if (argc != first || mode < 0 || (record_path && replay_path)) {
+        fprintf(stdout, "USAGE: %s [-m cells|half|braille] [-R recording | -P recording] [-f profile] [-T trace]", argv[0]);
+        return 1;
+    }
+#else
+    if (argc != first + 1 || mode < 0 || (record_path && replay_path)) {
+        fprintf(stdout, "USAGE: ./chip8 [-m cells|half|braille] [-R recording | -P recording] [-f profile] [-T trace] /path/to/rom");
+        return 1;
+    }
+#endif
 
     // CHIP8_init the CHIP-8 emulator with the user-specified rom
     CHIP8_init(&chip8);
-    CHIP8_load_rom_from_file(&chip8, argv[1]);
+
+    // the report is written to the profile file at every press of the profile key
+    if (!CHIP8_set_profiling(&chip8, profile_path != NULL)) {
+        fprintf(stderr, "Unable to profile: the core is compiled without CHIP8_PROFILE! Aborting...\n");
+        return 1;
+    }
+    atomic_init(&profile_requests, 0);
+
+    // the trace is written to the trace file on a crash, on SIGUSR1 and at every press of the trace key
+    trace_buffer_t *trace = NULL;
+    atomic_init(&trace_requests, 0);
+
+    if (trace_path) {
+        trace = trace_buffer_create(TRACE_ENTRIES);
+
+        if (!trace || !trace_buffer_dump_on_signal(trace, trace_path)) {
+            fprintf(stderr, "Unable to open the trace! Aborting...\n");
+            return 1;
+        }
+
+        CHIP8_set_trace(&chip8, trace);
+    }
+
+    window_setup();
+    text_renderer_init(&renderer, mode);
+
+#ifdef CHIP8_AOT
+    CHIP8_load_program(&chip8, &CHIP8_translated_program);
+#else
+    CHIP8_load_rom_from_file(&chip8, argv[first]);
+#endif
     CHIP8_set_refresh_function(&chip8, &refresh_screen);
+    CHIP8_set_present_mode(&chip8, CHIP8_PRESENT_VBLANK);
     CHIP8_set_beep_function(&chip8, &emit_beep);
-    CHIP8_set_keyboard_input_function(&chip8, &keyboard_input);
+
+    // sessions are recorded from the start, and replayed instead of reading the keyboard
+    input_record_t *replay = NULL;
+    int64_t replay_start = time_ms();
+
+    if ((record_path && !input_record_create(record_path, &chip8, (uint64_t) time(NULL)))
+        || (replay_path && !(replay = input_record_open(replay_path, &chip8)))) {
+        endwin();
+        fprintf(stderr, "Unable to open the recording! Aborting...\n");
+        return 1;
+    }
+
+    rewind_buffer_t *rewind_buffer = rewind_buffer_create(REWIND_BUDGET, REWIND_KEYFRAME_INTERVAL);
+    atomic_init(&rewind_requests, 0);
+
+    if (!rewind_buffer) {
+        endwin();
+        fprintf(stderr, "Unable to allocate the rewind buffer! Aborting...\n");
+        return 1;
+    }
+
+    // the emulator runs when a key event is queued or its deadline expires
+    int epoll = epoll_create1(0);
+    int timer = timerfd_create(CLOCK_MONOTONIC, 0);
+    struct epoll_event event = {.events = EPOLLIN};
+    pthread_t input, render;
+
+    key_queue_init(&key_queue);
+    key_event = eventfd(0, EFD_NONBLOCK);
+
+    // the screen is drawn by the render thread, so slow terminals do not stall the emulator
+    frame_buffer_init(&frame_buffer);
+    atomic_init(&pending_beeps, 0);
+    frame_event = eventfd(0, EFD_NONBLOCK);
+
+    event.data.fd = key_event;
+    if (epoll < 0 || timer < 0 || key_event < 0 || frame_event < 0
+        || epoll_ctl(epoll, EPOLL_CTL_ADD, key_event, &event)
+        || pthread_create(&input, NULL, &input_thread, NULL)
+        || pthread_create(&render, NULL, &render_thread, NULL)) {
+        endwin();
+        fprintf(stderr, "Unable to create the event loop! Aborting...\n");
+        return 1;
+    }
+
+    event.data.fd = timer;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
 
     // main loop emulating the cpu
-    CHIP8_loop(&chip8);
+    while (1) {
+        CHIP8_run_status status;
+        struct epoll_event events[2];
+
+        if (replay) {
+            // the recorded keys drive the emulator at its clock rate
+            uint64_t due = (uint64_t) (time_ms() - replay_start) * chip8.clock_rate / 1000;
+
+            if (due > chip8.cycle_count) {
+                input_replay_run(replay, &chip8, due - chip8.cycle_count);
+            }
+
+            CHIP8_arm_timer(timer, CHIP8_time_ns() + 1000000000 / TIMER_RATE);
+        } else {
+            key_queue_drain(&key_queue, &chip8);
+
+            // a recorded session cannot go back in time
+            int rewinds = atomic_exchange(&rewind_requests, 0);
+            if (rewinds && !record_path) {
+                rewind_buffer_step_back(rewind_buffer, &chip8, rewinds * REWIND_STEP);
+            }
+
+            CHIP8_run(&chip8, RUN_BUDGET, &status);
+            rewind_buffer_record(rewind_buffer, &chip8);
+            CHIP8_arm_timer(timer, status.deadline);
+        }
+
+        if (atomic_exchange(&profile_requests, 0) && profile_path) {
+            FILE *report = fopen(profile_path, "w");
+
+            if (report) {
+                profile_report(&chip8, report);
+                fclose(report);
+            }
+        }
+
+        // the dump runs in this thread, while the emulator is stopped
+        if (atomic_exchange(&trace_requests, 0) && trace) {
+            raise(SIGUSR1);
+        }
+
+        int ready = epoll_wait(epoll, events, 2, -1);
+        for (int i = 0; i < ready; i++) {
+            uint64_t count;
+            read(events[i].data.fd, &count, sizeof(count));
+        }
+    }
 }
 
 /**
@@ -42,51 +291,136 @@ void window_setup() {
     nodelay(window, TRUE);
     cbreak();
     curs_set(FALSE);
+
+    // from now on, the screen is drawn by the text renderer
+    refresh();
 }
 
 /**
- * Update the screen with the content of the video memory
- * of the emulator. The CHIP8 has a 64x32 monochromatic
- * screen.
+ * Hand a frame to the render thread. Called by the emulator.
  *
- * Currently, the screen is emulated using a curses window.
- * Lit pixels are represented with a '0' character. Since refreshing
- * the whole window is slow, this function tracks the previous
- * state of the window in the 'old' static variable.
+ * @param video is a pointer to the rows that contain the video state
+ */
+void refresh_screen(const uint64_t *video) {
+    uint64_t count = 1;
+
+    frame_buffer_publish(&frame_buffer, video);
+    write(frame_event, &count, sizeof(count));
+}
+
+/**
+ * Ask the render thread to emit a BEEP!
+ */
+void emit_beep() {
+    uint64_t count = 1;
+
+    atomic_fetch_add_explicit(&pending_beeps, 1, memory_order_relaxed);
+    write(frame_event, &count, sizeof(count));
+}
+
+/**
+ * Update the screen with the newest frame of the emulator.
+ * The CHIP8 has a 64x32 monochromatic screen.
  *
- * @param video is a pointer to the matrix the contains the video state
+ * The text renderer packs the pixels into character cells and only
+ * redraws the cells that changed, and the whole update (beep included)
+ * is sent to the terminal with a single system call. The frames that
+ * the emulator publishes while the terminal is busy are skipped.
  */
-void refresh_screen(const uint8_t *video) {
-    static int frame_counter = 0;
-    static uint8_t old[VIDEO_SIZE] = {0};
+void *render_thread(void *arg) {
+    (void) arg;
 
-    frame_counter++;
+    while (1) {
+        struct pollfd fd = {.fd = frame_event, .events = POLLIN};
+        struct iovec output[2] = {{"\a", 0}, {NULL, 0}};
+        uint64_t count;
 
-    for (int y = 0; y < 32; y++) {
-        for (int x = 0; x < 64; x++) {
-            if (old[y * 64 + x] ^ video[y * 64 + x]) {
-                move(y, x);
-                addch(video[y * 64 + x] ? '0' : ' ');
-                old[y * 64 + x] = video[y * 64 + x];
-            }
+        poll(&fd, 1, -1);
+        read(frame_event, &count, sizeof(count));
+
+        if (atomic_exchange_explicit(&pending_beeps, 0, memory_order_relaxed)) {
+            output[0].iov_len = 1;
         }
-    }
 
-    refresh();
+        const uint64_t *video = frame_buffer_acquire(&frame_buffer);
+        if (video) {
+            const char *cells;
+
+            output[1].iov_len = text_renderer_draw(&renderer, video, &cells);
+            output[1].iov_base = (void *) cells;
+        }
+
+        if (output[0].iov_len + output[1].iov_len) {
+            writev(STDOUT_FILENO, output, 2);
+        }
+    }
 }
 
 /**
- * Emit a BEEP!
+ * Read the keyboard and queue the key events for the main loop.
+ *
+ * Since the terminal only reports key presses, a key is released
+ * when it is not repeated for KEY_HOLD_TIME milliseconds.
  */
-void emit_beep() {
-    printf("\a\n");
+void *input_thread(void *arg) {
+    (void) arg;
+
+    // time at which each key is released, 0 for the keys that are up
+    int64_t release[NUM_KEYS] = {0};
+
+    while (1) {
+        int64_t now = time_ms();
+        int timeout = -1;
+
+        for (int i = 0; i < NUM_KEYS; i++) {
+            if (release[i] && (timeout < 0 || release[i] - now < timeout)) {
+                timeout = release[i] > now ? (int) (release[i] - now) : 0;
+            }
+        }
+
+        struct pollfd fd = {.fd = STDIN_FILENO, .events = POLLIN};
+        int queued = 0;
+        char key;
+
+        if (poll(&fd, 1, timeout) > 0 && read(STDIN_FILENO, &key, 1) == 1) {
+            int index = key_index(key);
+
+            if (key == REWIND_KEY) {
+                atomic_fetch_add(&rewind_requests, 1);
+                queued++;
+            } else if (key == PROFILE_KEY) {
+                atomic_fetch_add(&profile_requests, 1);
+                queued++;
+            } else if (key == TRACE_KEY) {
+                atomic_fetch_add(&trace_requests, 1);
+                queued++;
+            } else if (index >= 0 && release[index]) {
+                release[index] = time_ms() + KEY_HOLD_TIME;
+            } else if (index >= 0 && key_queue_push(&key_queue, (key_event_t) {index, 1})) {
+                // a press dropped by a full queue is not released later
+                release[index] = time_ms() + KEY_HOLD_TIME;
+                queued++;
+            }
+        }
+
+        now = time_ms();
+        for (int i = 0; i < NUM_KEYS; i++) {
+            // a release dropped by a full queue is retried
+            if (release[i] && release[i] <= now && key_queue_push(&key_queue, (key_event_t) {i, 0})) {
+                queued++;
+                release[i] = 0;
+            }
+        }
+
+        if (queued) {
+            uint64_t count = queued;
+            write(key_event, &count, sizeof(count));
+        }
+    }
 }
 
 /**
- * Read keyboard status.
- *
- * Since curses can only detect 'key down' events, the pressure
- * of a key activates it until the key is pressed again.
+ * Map a key of the physical keyboard to the CHIP8 keypad
  *
  * Physical keyboard   <-->   CHIP8 keypad
  *
@@ -95,30 +429,53 @@ void emit_beep() {
  *   a s d f                    7 8 9 E
  *   z x c v                    A 0 B F
  *
- * @param keyboard is a pointer to the matrix that represents the keyboard
- */
-void keyboard_input(uint8_t *keyboard) {
-    char key;
-
-    if ((key = getch()) != ERR) {
-        if (key == '1') keyboard[0x1] ^= 1;
-        else if (key == '2') keyboard[0x2] ^= 1;
-        else if (key == '3') keyboard[0x3] ^= 1;
-        else if (key == '4') keyboard[0xC] ^= 1;
-
-        else if (key == 'q') keyboard[0x4] ^= 1;
-        else if (key == 'w') keyboard[0x5] ^= 1;
-        else if (key == 'e') keyboard[0x6] ^= 1;
-        else if (key == 'r') keyboard[0xD] ^= 1;
-
-        else if (key == 'a') keyboard[0x7] ^= 1;
-        else if (key == 's') keyboard[0x8] ^= 1;
-        else if (key == 'd') keyboard[0x9] ^= 1;
-        else if (key == 'f') keyboard[0xE] ^= 1;
-
-        else if (key == 'z') keyboard[0xA] ^= 1;
-        else if (key == 'x') keyboard[0x0] ^= 1;
-        else if (key == 'c') keyboard[0xB] ^= 1;
-        else if (key == 'v') keyboard[0xF] ^= 1;
-    }
+ * @param key is the pressed key
+ * @return the index of the CHIP8 key, or -1 if the key is not mapped
+ */
+int key_index(char key) {
+    if (key == '1') return 0x1;
+    else if (key == '2') return 0x2;
+    else if (key == '3') return 0x3;
+    else if (key == '4') return 0xC;
+
+    else if (key == 'q') return 0x4;
+    else if (key == 'w') return 0x5;
+    else if (key == 'e') return 0x6;
+    else if (key == 'r') return 0xD;
+
+    else if (key == 'a') return 0x7;
+    else if (key == 's') return 0x8;
+    else if (key == 'd') return 0x9;
+    else if (key == 'f') return 0xE;
+
+    else if (key == 'z') return 0xA;
+    else if (key == 'x') return 0x0;
+    else if (key == 'c') return 0xB;
+    else if (key == 'v') return 0xF;
+
+    return -1;
+}
+
+/**
+ * Return the CLOCK_MONOTONIC time in milliseconds
+ */
+int64_t time_ms() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+/**
+ * Parse the name of a text render mode
+ *
+ * @param name is the name of the mode: cells, half or braille
+ * @return the mode, or -1 if the name is not valid
+ */
+int render_mode(const char *name) {
+    if (!strcmp(name, "cells")) return TEXT_RENDER_CELLS;
+    else if (!strcmp(name, "half")) return TEXT_RENDER_HALF_BLOCKS;
+    else if (!strcmp(name, "braille")) return TEXT_RENDER_BRAILLE;
+
+    return -1;
 }
\ No newline at end of file
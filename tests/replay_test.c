@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core/CHIP-8.h"
+#include "core/input_record.h"
+
+/**
+ * Record/replay test: a session is recorded on a machine whose storage
+ * is full of garbage, like the stack-allocated emulator of the terminal
+ * frontend, and replayed on zeroed machines with every engine. Each
+ * replay must end in the state of the recording (same CHIP8_state_hash).
+ *
+ * The keys are pressed and released in a fixed pattern while the
+ * recording runs, at cycles that do not line up with the steps.
+ */
+
+#define CYCLES 2000000
+#define SEED 0x5EED
+#define KEY_PERIOD 7919
+
+static const char *engines[] = {"interpreter", "block_cache", "superinstructions", "jit"};
+
+static uint64_t record_session(const char *rom, const char *path);
+
+static uint64_t replay_session(const char *rom, const char *path, CHIP8_engine engine);
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stdout, "USAGE: ./replay_test /path/to/rom\n");
+        return 1;
+    }
+
+    char path[] = "/tmp/chip8_replay_XXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd < 0) {
+        fprintf(stderr, "Unable to create the recording! Aborting...\n");
+        return 1;
+    }
+
+    close(fd);
+
+    uint64_t expected = record_session(argv[1], path);
+    int failures = 0;
+
+    for (int engine = 0; engine < (int) (sizeof(engines) / sizeof(engines[0])); engine++) {
+        uint64_t hash = replay_session(argv[1], path, (CHIP8_engine) engine);
+
+        fprintf(stdout, "%s %s: %016llx (recorded %016llx)\n", hash == expected ? "PASS" : "FAIL",
+                engines[engine], (unsigned long long) hash, (unsigned long long) expected);
+        failures += hash != expected;
+    }
+
+    unlink(path);
+    return failures ? 2 : 0;
+}
+
+/**
+ * Record CYCLES cycles of the rom on a machine that is not zeroed
+ */
+static uint64_t record_session(const char *rom, const char *path) {
+    CHIP8 *chip8 = malloc(sizeof(CHIP8));
+
+    if (!chip8) {
+        fprintf(stderr, "Unable to allocate the emulator! Aborting...\n");
+        exit(1);
+    }
+
+    memset(chip8, 0xAB, sizeof(CHIP8));
+    CHIP8_init(chip8);
+    CHIP8_load_rom_from_file(chip8, (char *) rom);
+
+    input_record_t *record = input_record_create(path, chip8, SEED);
+
+    if (!record) {
+        fprintf(stderr, "Unable to write the recording! Aborting...\n");
+        exit(1);
+    }
+
+    uint64_t next_key = KEY_PERIOD;
+    int key = 0, down = 0;
+
+    while (chip8->cycle_count < CYCLES) {
+        // the last cycles are ticked to stop exactly at CYCLES
+        if (CYCLES - chip8->cycle_count > CHIP8_MAX_STEP_CYCLES) {
+            CHIP8_step(chip8);
+        } else {
+            CHIP8_tick(chip8);
+        }
+
+        if (chip8->cycle_count >= next_key) {
+            CHIP8_key_event(chip8, key, !down);
+            key = down ? (key + 5) % NUM_KEYS : key;
+            down = !down;
+            next_key += KEY_PERIOD;
+        }
+    }
+
+    uint64_t hash = CHIP8_state_hash(chip8);
+
+    input_record_close(record);
+    free(chip8);
+
+    return hash;
+}
+
+/**
+ * Replay the recording on a zeroed machine with the given engine
+ */
+static uint64_t replay_session(const char *rom, const char *path, CHIP8_engine engine) {
+    static CHIP8 chip8;
+
+    CHIP8_init(&chip8);
+    CHIP8_load_rom_from_file(&chip8, (char *) rom);
+    CHIP8_set_engine(&chip8, engine);
+
+    input_record_t *replay = input_record_open(path, &chip8);
+
+    if (!replay) {
+        fprintf(stderr, "Unable to read the recording! Aborting...\n");
+        exit(1);
+    }
+
+    input_replay_run(replay, &chip8, CYCLES);
+    input_record_close(replay);
+
+    uint64_t hash = CHIP8_state_hash(&chip8);
+    CHIP8_set_engine(&chip8, CHIP8_ENGINE_INTERPRETER);
+
+    return hash;
+}
\ No newline at end of file
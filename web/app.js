@@ -7,6 +7,7 @@ Module.onRuntimeInitialized = async _ => {
         initialize: Module.cwrap('CHIP8_wasm_initialize', 'number', ['number', 'number']),
         tick: Module.cwrap('CHIP8_wasm_tick', 'number', []),
         get_video: Module.cwrap('CHIP8_wasm_get_video', 'number', []),
+        get_dirty_rows: Module.cwrap('CHIP8_wasm_get_dirty_rows', 'number', []),
         get_PC: Module.cwrap('CHIP8_wasm_get_PC', 'number', []),
         get_register_file: Module.cwrap('CHIP8_wasm_get_register_file', 'number', []),
         set_key_down: Module.cwrap('CHIP8_wasm_set_key_down', '', ['number']),
@@ -53,10 +54,16 @@ Module.onRuntimeInitialized = async _ => {
             }
 
             if (draw_flag) {
-                context.clearRect(0, 0, c.width, c.height);
+                CHIP8.get_video();
+                let dirty = CHIP8.get_dirty_rows();
 
                 context.beginPath();
                 for (let y = 0; y < 32; y++) {
+                    if (!((dirty >>> y) & 1)) {
+                        continue;
+                    }
+
+                    context.clearRect(0, y * 10, c.width, 10);
                     for (let x = 0; x < 64; x++) {
                         if (video[y * 64 + x]) {
                             context.fillRect(x * 10, y * 10, 10, 10);